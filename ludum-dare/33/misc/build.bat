@@ -11,6 +11,8 @@ set compiler_flags=-std=c++11 ^
 	-O0
 :: For some reason, optimizations like O2 etc. make it slower!!!
 :: TODO(bill): Figure out why
+:: Add -s USE_PTHREADS=1 to simulate and render on separate threads, see
+:: FRAME_LATENCY in main.cpp. The page then needs cross-origin isolation.
 
 emcc src\unity_build.cpp %compiler_flags% -o game.js
 
@@ -0,0 +1,16 @@
+@echo off
+
+pushd W:\LudumDare\LD33
+
+set compiler_flags=-std=c++11 ^
+	-s USE_SDL=1 ^
+	-s USE_PTHREADS=1 -s PTHREAD_POOL_SIZE=8 ^
+	--embed-file res@/ ^
+	-s ALLOW_MEMORY_GROWTH=1 ^
+	-Wno-c++11-narrowing -Wno-absolute-value ^
+	-O2
+:: Run with: node batch_sim.js [runs] [threads] [max_ticks]
+
+emcc src\batch_sim.cpp %compiler_flags% -o batch_sim.js
+
+popd
@@ -0,0 +1,14 @@
+@echo off
+
+pushd W:\LudumDare\LD33
+
+set compiler_flags=-std=c++11 ^
+	-s USE_SDL=1 ^
+	-s ALLOW_MEMORY_GROWTH=1 ^
+	-Wno-c++11-narrowing -Wno-absolute-value ^
+	-O2
+:: Run with: node benchmark.js [ticks] [seed]
+
+emcc src\benchmark.cpp %compiler_flags% -o benchmark.js
+
+popd
@@ -0,0 +1,16 @@
+@echo off
+
+pushd W:\LudumDare\LD33
+
+set compiler_flags=-std=c++11 ^
+	-s USE_SDL=1 ^
+	-s NODERAWFS=1 ^
+	-s ALLOW_MEMORY_GROWTH=1 ^
+	-Wno-c++11-narrowing -Wno-absolute-value ^
+	-O2
+:: NODERAWFS so it reads and writes the real res folder, nothing is embedded
+:: Run with: node level_compiler.js res\level001.png res\level001.level [--chunked]
+
+emcc src\level_compiler.cpp %compiler_flags% -o level_compiler.js
+
+popd
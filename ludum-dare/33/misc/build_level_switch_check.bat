@@ -0,0 +1,16 @@
+@echo off
+
+pushd W:\LudumDare\LD33
+
+set compiler_flags=-std=c++11 ^
+	-s USE_SDL=1 ^
+	-s USE_PTHREADS=1 -s PTHREAD_POOL_SIZE=2 ^
+	--embed-file res@/ ^
+	-s ALLOW_MEMORY_GROWTH=1 ^
+	-Wno-c++11-narrowing -Wno-absolute-value ^
+	-O2
+:: Run with: node level_switch_check.js [current] [next]
+
+emcc src\level_switch_check.cpp %compiler_flags% -o level_switch_check.js
+
+popd
@@ -0,0 +1,15 @@
+@echo off
+
+pushd W:\LudumDare\LD33
+
+set compiler_flags=-std=c++11 ^
+	-s USE_SDL=1 ^
+	--embed-file res@/ ^
+	-s ALLOW_MEMORY_GROWTH=1 ^
+	-Wno-c++11-narrowing -Wno-absolute-value ^
+	-O2
+:: Run with: node sim_check.js [ticks] [seed]
+
+emcc src\sim_check.cpp %compiler_flags% -o sim_check.js
+
+popd
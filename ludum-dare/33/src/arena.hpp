@@ -0,0 +1,102 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include "common.hpp"
+
+////////////////////////////////
+// Memory arena
+////////////////////////////////
+
+// NOTE(bill): Bump allocator over a chain of blocks. Nothing is freed on its
+// own, the whole arena goes at once with `destroy_arena`. The `Arena` itself
+// lives at the start of its first block.
+
+constexpr size_t ARENA_ALIGNMENT = 16;
+
+struct Arena_Block {
+	Arena_Block* prev;
+	size_t size; // NOTE(bill): Usable bytes after the header
+	size_t used;
+};
+
+struct Arena {
+	Arena_Block* block;
+	size_t block_size; // NOTE(bill): Smallest block to ask for when full
+	size_t total_size; // All blocks, headers included
+};
+
+inline size_t
+align_arena_size(size_t size)
+{
+	return (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+inline Arena_Block*
+push_arena_block(Arena& arena, size_t size)
+{
+	if (size < arena.block_size)
+		size = arena.block_size;
+
+	const size_t header = align_arena_size(sizeof(Arena_Block));
+	Arena_Block* block  = (Arena_Block*)malloc(header + size);
+	if (block == nullptr)
+		return nullptr;
+
+	block->prev = arena.block;
+	block->size = size;
+	block->used = 0;
+	arena.block = block;
+	arena.total_size += header + size;
+	return block;
+}
+
+// NOTE(bill): Zeroed and `ARENA_ALIGNMENT` aligned, null when out of memory
+inline void*
+arena_alloc(Arena& arena, size_t size)
+{
+	size = align_arena_size(size);
+
+	Arena_Block* block = arena.block;
+	if (block == nullptr || block->used + size > block->size) {
+		block = push_arena_block(arena, size);
+		if (block == nullptr)
+			return nullptr;
+	}
+
+	u8* memory = (u8*)block + align_arena_size(sizeof(Arena_Block)) + block->used;
+	block->used += size;
+	memset(memory, 0, size);
+	return memory;
+}
+
+// NOTE(bill): One block of `size` to start with, the arena header included
+inline Arena*
+create_arena(size_t size)
+{
+	Arena bootstrap      = {};
+	bootstrap.block_size = size + align_arena_size(sizeof(Arena));
+
+	Arena* arena = (Arena*)arena_alloc(bootstrap, sizeof(Arena));
+	if (arena == nullptr)
+		return nullptr;
+
+	*arena            = bootstrap;
+	arena->block_size = size;
+	return arena;
+}
+
+inline void
+destroy_arena(Arena* arena)
+{
+	if (arena == nullptr)
+		return;
+
+	Arena_Block* block = arena->block; // NOTE(bill): `arena` is gone once its block is
+	while (block) {
+		Arena_Block* prev = block->prev;
+		free(block);
+		block = prev;
+	}
+}
+
+#endif
@@ -0,0 +1,162 @@
+#include "batch.hpp"
+
+// NOTE(bill): `keys` must be MAX_KEYS long and is only touched by this run
+void
+simulate_run(const Batch_Config& config, Batch_Run& run, u8* keys)
+{
+	Game* game = (Game*)calloc(1, sizeof(Game));
+	defer(free(game));
+
+	game->level001 = instance_level(*config.level);
+	defer(destroy_level_instance(&game->level001));
+
+	game->curr_level = &game->level001;
+	game->keys       = keys;
+	game->headless   = true;
+	seed_game_random(*game, run.seed);
+	reset_player(*game);
+
+	memset(keys, 0, MAX_KEYS);
+	Random_Series bot_rng = random_series(run.seed, RANDOM_STREAM_BOT);
+
+	while (game->tick < config.max_ticks && !game->has_finished) {
+		config.bot(*game, bot_rng, keys);
+		update_game(*game, TIME_STEP);
+	}
+
+	run.ticks         = game->tick;
+	run.player_died   = game->player.health <= 0;
+	run.boss_killed   = game->has_finished && !run.player_died;
+	run.health        = game->player.health;
+	run.spell_count   = game->player.spell_count;
+	run.entities_left = game->curr_level->entity_count;
+}
+
+////////////////////////////////
+// Work-Stealing Pool
+////////////////////////////////
+
+// NOTE(bill): Each worker owns a contiguous range of run indices. The owner
+// takes from the back; an idle worker steals the front half of another's range.
+// Runs are whole playthroughs so a lock per range costs nothing measurable.
+struct Batch_Worker {
+	std::mutex mutex;
+	int begin;
+	int end;
+
+	u64 steals;
+	u64 ticks;
+	u8 keys[MAX_KEYS];
+};
+
+internal b32
+pop_run(Batch_Worker& worker, int* index)
+{
+	std::lock_guard<std::mutex> lock(worker.mutex);
+	if (worker.begin >= worker.end)
+		return false;
+
+	*index = --worker.end;
+	return true;
+}
+
+internal b32
+steal_runs(Batch_Worker* workers, int worker_count, int self)
+{
+	for (int offset = 1; offset < worker_count; offset++) {
+		Batch_Worker& victim = workers[(self + offset) % worker_count];
+
+		int begin = 0;
+		int end   = 0;
+		{
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			const int remaining = victim.end - victim.begin;
+			if (remaining <= 0)
+				continue;
+
+			begin = victim.begin;
+			end   = begin + (remaining + 1) / 2;
+			victim.begin = end;
+		}
+
+		Batch_Worker& thief = workers[self];
+		std::lock_guard<std::mutex> lock(thief.mutex);
+		thief.begin = begin;
+		thief.end   = end;
+		thief.steals++;
+		return true;
+	}
+
+	// NOTE(bill): Nothing queued anywhere and no run ever spawns more, so we are done
+	return false;
+}
+
+internal void
+batch_worker_proc(const Batch_Config* config, Batch_Run* runs,
+                  Batch_Worker* workers, int worker_count, int self)
+{
+	Batch_Worker& worker = workers[self];
+
+	for (;;) {
+		int index = 0;
+		if (pop_run(worker, &index)) {
+			simulate_run(*config, runs[index], worker.keys);
+			worker.ticks += runs[index].ticks;
+			continue;
+		}
+
+		if (!steal_runs(workers, worker_count, self))
+			break;
+	}
+}
+
+Batch_Stats
+run_batch(const Batch_Config& config, Batch_Run* runs, int run_count)
+{
+	Batch_Stats stats = {};
+
+	int thread_count = config.thread_count;
+	if (thread_count <= 0)
+		thread_count = (int)std::thread::hardware_concurrency();
+	if (thread_count <= 0)
+		thread_count = 1;
+	if (thread_count > run_count)
+		thread_count = run_count > 0 ? run_count : 1;
+
+	Batch_Worker* workers = new Batch_Worker[thread_count];
+	defer(delete[] workers);
+
+	// NOTE(bill): Deal out even ranges, stealing evens out the long runs
+	for (int i = 0; i < thread_count; i++) {
+		workers[i].begin  = (int)((s64)run_count * i / thread_count);
+		workers[i].end    = (int)((s64)run_count * (i + 1) / thread_count);
+		workers[i].steals = 0;
+		workers[i].ticks  = 0;
+	}
+
+	const f64 start_time = emscripten_get_now();
+
+	std::thread* threads = new std::thread[thread_count - 1];
+	defer(delete[] threads);
+	for (int i = 1; i < thread_count; i++)
+		threads[i - 1] = std::thread(batch_worker_proc, &config, runs, workers, thread_count, i);
+
+	batch_worker_proc(&config, runs, workers, thread_count, 0);
+
+	for (int i = 1; i < thread_count; i++)
+		threads[i - 1].join();
+
+	stats.thread_count = thread_count;
+	stats.seconds      = (emscripten_get_now() - start_time) / 1000.0;
+	for (int i = 0; i < thread_count; i++) {
+		stats.total_ticks += workers[i].ticks;
+		stats.steals += workers[i].steals;
+	}
+
+	if (stats.seconds > 0) {
+		stats.runs_per_second          = run_count / stats.seconds;
+		stats.runs_per_second_per_core = stats.runs_per_second / thread_count;
+	}
+
+	return stats;
+}
@@ -0,0 +1,48 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include "game.hpp"
+
+// NOTE(bill): Runs many independent headless playthroughs of one level in
+// parallel. Every run gets its own `Game`, entities and RNG; the level grid is
+// shared read-only. Runs are spread over a work-stealing thread pool.
+
+// NOTE(bill): Fills `keys` for the next tick, it may only read the game
+typedef void (*Bot_Proc)(const Game& game, Random_Series& rng, u8* keys);
+
+struct Batch_Config {
+	const Level* level; // NOTE(bill): Shared read-only by every run
+	Bot_Proc bot;
+	u32 max_ticks;
+	int thread_count; // NOTE(bill): 0 uses every core
+};
+
+struct Batch_Run {
+	u32 seed;
+
+	// NOTE(bill): Results
+	u32 ticks;
+	b32 player_died;
+	b32 boss_killed;
+	f32 health;
+	int spell_count;
+	int entities_left;
+};
+
+struct Batch_Stats {
+	int thread_count;
+	f64 seconds;
+	u64 total_ticks;
+	u64 steals;
+
+	f64 runs_per_second;
+	f64 runs_per_second_per_core;
+};
+
+void
+simulate_run(const Batch_Config& config, Batch_Run& run, u8* keys);
+
+Batch_Stats
+run_batch(const Batch_Config& config, Batch_Run* runs, int run_count);
+
+#endif
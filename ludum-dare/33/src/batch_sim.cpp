@@ -0,0 +1,87 @@
+// Batch Simulation
+//
+// Headless unity build: plays level001.png many times with a wandering bot
+// across every core and reports playthroughs per second per core. A sample of
+// the runs is replayed on one thread to check they do not depend on scheduling.
+//
+// Usage: batch_sim [runs] [threads] [max_ticks]
+
+#include "bitmap.cpp"
+#include "level.cpp"
+#include "level_manager.cpp"
+#include "game.cpp"
+#include "batch.cpp"
+
+// NOTE(bill): About once a second picks new keys, and only casts while it
+// has spells left
+internal void
+wander_bot(const Game& game, Random_Series& rng, u8* keys)
+{
+	if ((random_u32(rng) % 64) != 0)
+		return;
+
+	keys[SDLK_UP]    = random_unit(rng) < 0.8f;
+	keys[SDLK_LEFT]  = random_unit(rng) < 0.25f;
+	keys[SDLK_RIGHT] = random_unit(rng) < 0.25f;
+	keys[SDLK_SPACE] = game.player.spell_count > 0 && random_unit(rng) < 0.3f;
+}
+
+int
+main(int argc, char** argv)
+{
+	const int run_count    = argc > 1 ? atoi(argv[1]) : 1024;
+	const int thread_count = argc > 2 ? atoi(argv[2]) : 0;
+	const u32 max_ticks    = argc > 3 ? (u32)atoi(argv[3]) : 60 * 60;
+
+	if (run_count <= 0)
+		return 1;
+
+	Level level = load_level_from_file("level001.png");
+	if (level.grid == nullptr)
+		return 1;
+	defer(destroy_level(&level));
+
+	Batch_Config config = {};
+	config.level        = &level;
+	config.bot          = wander_bot;
+	config.max_ticks    = max_ticks;
+	config.thread_count = thread_count;
+
+	Batch_Run* runs = (Batch_Run*)calloc(run_count, sizeof(Batch_Run));
+	defer(free(runs));
+	for (int i = 0; i < run_count; i++)
+		runs[i].seed = 0x1d33 + i;
+
+	const Batch_Stats stats = run_batch(config, runs, run_count);
+
+	int deaths      = 0;
+	int boss_kills  = 0;
+	int spell_total = 0;
+	for (int i = 0; i < run_count; i++) {
+		deaths += runs[i].player_died;
+		boss_kills += runs[i].boss_killed;
+		spell_total += runs[i].spell_count;
+	}
+
+	// NOTE(bill): Same seed, same result, whichever thread ran it
+	int mismatches = 0;
+	local_persist u8 keys[MAX_KEYS];
+	for (int i = 0; i < run_count && i < 32; i++) {
+		Batch_Run check = {};
+		check.seed      = runs[i].seed;
+		simulate_run(config, check, keys);
+		if (memcmp(&check, &runs[i], sizeof(Batch_Run)) != 0)
+			mismatches++;
+	}
+
+	printf("[Batch] %d runs of up to %u ticks on %d threads in %.2f s (%llu steals)\n",
+	       run_count, max_ticks, stats.thread_count, stats.seconds, (unsigned long long)stats.steals);
+	printf("[Batch] %.1f runs/s, %.1f runs/s/core, %.0f ticks/s/core\n",
+	       stats.runs_per_second, stats.runs_per_second_per_core,
+	       stats.total_ticks / stats.seconds / stats.thread_count);
+	printf("[Batch] %d deaths, %d boss kills, %.2f spells per run\n",
+	       deaths, boss_kills, (f64)spell_total / run_count);
+	printf("[Batch] %d mismatched reruns\n", mismatches);
+
+	return mismatches == 0 ? 0 : 1;
+}
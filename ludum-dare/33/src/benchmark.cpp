@@ -0,0 +1,169 @@
+// Entity Throughput Benchmark
+//
+// Headless unity build: builds synthetic levels crowded with a single
+// `Entity_Type`, runs `update_game` for a fixed number of ticks with a fixed
+// seed and reports ns per entity per tick for each subsystem. Only entities
+// near the player get updated every tick (see `LOD_NEAR_DISTANCE`), so how
+// many ended up in each tier is reported alongside.
+//
+// Usage: benchmark [ticks] [seed]
+
+#include "bitmap.cpp"
+#include "level.cpp"
+#include "level_manager.cpp"
+#include "game.cpp"
+
+struct Benchmark_Type {
+	Entity_Type type;
+	const char* name;
+};
+
+global const Benchmark_Type BENCHMARK_TYPES[] = {
+    {ENTITY_PORTAL, "portal"},
+    {ENTITY_SCROLL, "scroll"},
+    {ENTITY_HEALTH_POTION, "health_potion"},
+    {ENTITY_MANA_POTION, "mana_potion"},
+    {ENTITY_PRISONER, "prisoner"},
+    {ENTITY_PRISON_GUARD, "prison_guard"},
+    {ENTITY_MAGE, "mage"},
+    {ENTITY_BOSS, "boss"},
+};
+
+global const int BENCHMARK_COUNTS[] = {1000, 10000, 100000};
+
+internal Entity
+create_benchmark_entity(Entity_Type type, const Vector3& position, int index)
+{
+	if (type == ENTITY_PORTAL)
+		return create_portal(position, index & 15, (index + 1) & 15);
+	return create_entity(type, position);
+}
+
+// NOTE(bill): Walled border with scattered pillars, roughly two tiles per entity
+internal Level
+create_benchmark_level(Entity_Type type, int entity_count, Random_Series& rng)
+{
+	Level level = {};
+
+	int size = 2;
+	while (size * size < 2 * entity_count)
+		size++;
+	size += 2;
+
+	create_level_grid(level, size, size);
+
+	for (int y = 0; y < level.height; y++) {
+		for (int x = 0; x < level.width; x++) {
+			Tile tile    = {};
+			tile.type    = TILE_FLOOR;
+			tile.ceiling = 0x00;
+			tile.floor   = 0x10;
+
+			if (x == 0 || y == 0 || x == level.width - 1 || y == level.height - 1)
+				tile.type = TILE_WALL;
+			else if ((random_u32(rng) & 15) == 0)
+				tile.type = TILE_WALL;
+
+			set_tile(level, tile, x, y);
+		}
+	}
+
+	level.init_position = {size / 2, size / 2};
+	set_tile(level, {0x10, 0x00, TILE_FLOOR, 0}, size / 2, size / 2);
+
+	while (level.entity_count < entity_count) {
+		const int x = 1 + random_u32(rng) % (size - 2);
+		const int y = 1 + random_u32(rng) % (size - 2);
+		if (get_tile(level, x, y).type != TILE_FLOOR)
+			continue;
+
+		add_entity(level, create_benchmark_entity(type, {x, y, 0}, level.entity_count));
+	}
+
+	return level;
+}
+
+struct Benchmark_Result {
+	Tick_Timings timings;
+
+	// NOTE(bill): Entities in each simulation LOD tier after the last tick
+	int near_count;
+	int mid_count;
+	int far_count;
+};
+
+internal Benchmark_Result
+run_benchmark(Entity_Type type, int entity_count, int ticks, u32 seed)
+{
+	Random_Series level_rng = random_series(seed);
+
+	local_persist u8 keys[MAX_KEYS] = {}; // NOTE(bill): Nothing is ever pressed
+
+	Game game = {};
+
+	Level level = create_benchmark_level(type, entity_count, level_rng);
+	defer(destroy_level(&level));
+	game.curr_level = &level;
+	game.keys       = keys;
+	game.headless   = true;
+	seed_game_random(game, seed);
+
+	reset_player(game);
+
+	// NOTE(bill): Keep the player alive so every tick does the same work
+	game.player.max_health = game.player.health = 1e9f;
+
+	Benchmark_Result result = {};
+	game.timings            = &result.timings;
+
+	for (int tick = 0; tick < ticks; tick++) {
+		game.has_finished = false;
+		game.curr_time    = (u32)(1000.0f * tick * TIME_STEP);
+		update_game(game, TIME_STEP);
+	}
+
+	for (int i = 0; i < level.entity_count; i++) {
+		const Vector3 dpos   = game.player.position - level.entity_hot[i].position;
+		const f32 distance_2 = dot(dpos, dpos);
+		if (distance_2 <= LOD_NEAR_DISTANCE * LOD_NEAR_DISTANCE)
+			result.near_count++;
+		else if (distance_2 <= LOD_MID_DISTANCE * LOD_MID_DISTANCE)
+			result.mid_count++;
+		else
+			result.far_count++;
+	}
+
+	return result;
+}
+
+int
+main(int argc, char** argv)
+{
+	const int ticks = argc > 1 ? atoi(argv[1]) : 600;
+	const u32 seed  = argc > 2 ? (u32)atoi(argv[2]) : 0x1d33;
+
+	printf("[Benchmark] %d ticks, seed 0x%x, ns per entity per tick\n", ticks, seed);
+	printf("%-14s %8s %16s %16s %17s %20s %6s %6s %8s\n",
+	       "type", "count",
+	       "update_entities", "update_particles",
+	       "handle_collisions", "remove_dead_entities",
+	       "near", "mid", "far");
+
+	for (const Benchmark_Type& bt : BENCHMARK_TYPES) {
+		for (int count : BENCHMARK_COUNTS) {
+			const Benchmark_Result r = run_benchmark(bt.type, count, ticks, seed);
+			const Tick_Timings& t    = r.timings;
+			const f64 scale          = 1e6 / ((f64)count * ticks); // NOTE(bill): ms to ns
+
+			printf("%-14s %8d %16.3f %16.3f %17.3f %20.3f %6d %6d %8d\n",
+			       bt.name, count,
+			       t.update_entities * scale,
+			       t.update_particles * scale,
+			       t.handle_collisions * scale,
+			       t.remove_dead_entities * scale,
+			       r.near_count, r.mid_count, r.far_count);
+		}
+	}
+
+	return 0;
+}
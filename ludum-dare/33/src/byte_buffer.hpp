@@ -0,0 +1,144 @@
+#ifndef BYTE_BUFFER_HPP
+#define BYTE_BUFFER_HPP
+
+#include "common.hpp"
+
+////////////////////////////////
+// Growable byte buffer with LEB128 varints
+////////////////////////////////
+
+struct Byte_Buffer {
+	u8* data;
+	int size;
+	int capacity;
+	int cursor; // NOTE(bill): Read position
+};
+
+inline void
+destroy_byte_buffer(Byte_Buffer* buffer)
+{
+	if (buffer) {
+		free(buffer->data);
+		*buffer = {};
+	}
+}
+
+inline void
+clear_byte_buffer(Byte_Buffer& buffer)
+{
+	buffer.size   = 0;
+	buffer.cursor = 0;
+}
+
+inline void
+reserve_bytes(Byte_Buffer& buffer, int extra)
+{
+	if (buffer.size + extra <= buffer.capacity)
+		return;
+
+	int capacity = 2 * buffer.capacity;
+	if (capacity < buffer.size + extra)
+		capacity = buffer.size + extra;
+	if (capacity < 256)
+		capacity = 256;
+
+	buffer.data     = (u8*)realloc(buffer.data, capacity);
+	buffer.capacity = capacity;
+}
+
+inline void
+write_bytes(Byte_Buffer& buffer, const void* data, int size)
+{
+	reserve_bytes(buffer, size);
+	memcpy(buffer.data + buffer.size, data, size);
+	buffer.size += size;
+}
+
+inline void
+write_u8(Byte_Buffer& buffer, u8 value)
+{
+	reserve_bytes(buffer, 1);
+	buffer.data[buffer.size++] = value;
+}
+
+inline void
+write_varint(Byte_Buffer& buffer, u64 value)
+{
+	reserve_bytes(buffer, 10);
+	while (value >= 0x80) {
+		buffer.data[buffer.size++] = (u8)(value | 0x80);
+		value >>= 7;
+	}
+	buffer.data[buffer.size++] = (u8)value;
+}
+
+// NOTE(bill): Small magnitudes of either sign stay small
+inline void
+write_zigzag(Byte_Buffer& buffer, s32 value)
+{
+	write_varint(buffer, ((u32)value << 1) ^ (u32)(value >> 31));
+}
+
+inline b32
+read_bytes(Byte_Buffer& buffer, void* data, int size)
+{
+	if (buffer.cursor + size > buffer.size)
+		return false;
+
+	memcpy(data, buffer.data + buffer.cursor, size);
+	buffer.cursor += size;
+	return true;
+}
+
+inline b32
+read_u8(Byte_Buffer& buffer, u8* value)
+{
+	if (buffer.cursor >= buffer.size)
+		return false;
+
+	*value = buffer.data[buffer.cursor++];
+	return true;
+}
+
+inline b32
+read_varint(Byte_Buffer& buffer, u64* value)
+{
+	u64 result = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		if (buffer.cursor >= buffer.size)
+			return false;
+
+		const u8 byte = buffer.data[buffer.cursor++];
+		result |= (u64)(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0) {
+			*value = result;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+inline b32
+read_varint(Byte_Buffer& buffer, u32* value)
+{
+	u64 v = 0;
+	if (!read_varint(buffer, &v) || v > 0xffffffff)
+		return false;
+
+	*value = (u32)v;
+	return true;
+}
+
+inline b32
+read_zigzag(Byte_Buffer& buffer, s32* value)
+{
+	u32 v = 0;
+	if (!read_varint(buffer, &v))
+		return false;
+
+	*value = (s32)((v >> 1) ^ (0 - (v & 1)));
+	return true;
+}
+
+#endif
@@ -7,13 +7,25 @@
 #include <emscripten/emscripten.h>
 #include <SDL/SDL.h>
 #include <SDL/SDL_mixer.h>
-#include <functional> // Needed for `defer`
+#include <assert.h>           // Needed for level.hpp
+#include <atomic>             // Needed for level_manager.hpp
+#include <condition_variable> // Needed for main.cpp
+#include <fcntl.h>            // Needed for level.cpp
+#include <functional>         // Needed for `defer`
 #include <math.h>
+#include <mutex>  // Needed for batch.cpp
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h> // Needed for level.cpp
+#include <sys/stat.h> // Needed for level.cpp
+#include <thread> // Needed for batch.cpp
 #include <time.h>
+#include <unistd.h> // Needed for level.cpp
+#if defined(__SSE__)
+#include <xmmintrin.h> // Needed for math_batch.hpp
+#endif
 
 ////////////////////////////////
 // `static` means many things
@@ -29,7 +29,7 @@ create_framebuffer(int width, int height)
 b32
 init(Game& game)
 {
-	srand(time(nullptr));
+	seed_game_random(game, time(nullptr));
 
 	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) != 0) {
 		sdl_error("SDL_Init");
@@ -52,15 +52,6 @@ init(Game& game)
 	game.display = create_framebuffer(SCREEN_WIDTH, SCREEN_HEIGHT);
 	printf("[Game] Create Framebuffer\n");
 
-	game.player.fov   = 1.0f / (f32)game.display.height;
-	game.player.z     = 0.1f;
-	game.player.pitch = -0.1f;
-	game.player.yaw   = -TAU / 4;
-
-	game.player.max_health = game.player.health = 4.0f;
-	game.player.max_mana = game.player.mana = 20.0f;
-	printf("[Game] player Init\n");
-
 	art::title_screen = load_bitmap_from_file("title_screen.png");
 	art::floors       = load_bitmap_from_file("floors.png");
 	art::sprites      = load_bitmap_from_file("sprites.png");
@@ -77,20 +68,25 @@ init(Game& game)
 	music::main = Mix_LoadMUS("main_music.ogg");
 	printf("[Game] Load Music\n");
 
-	game.level001   = load_level_from_file("level001.png");
-	game.curr_level = &game.level001;
+	game.levels          = new Level_Manager();
+	const int level_slot = request_level(*game.levels, "level001.level");
+	game.curr_level      = wait_for_level(*game.levels, level_slot);
+	if (game.curr_level == nullptr) {
+		unload_level(*game.levels, level_slot); // NOTE(bill): Not compiled, see level_compiler.cpp
+		game.curr_level = wait_for_level(*game.levels, request_level(*game.levels, "level001.png"));
+	}
+	if (game.curr_level == nullptr)
+		return false;
 	printf("[Game] Load Levels\n");
 
 	if (!Mix_PlayingMusic()) {
 		Mix_PlayMusic(music::main, -1);
 	}
 
-	game.player.x = game.curr_level->init_position.x;
-	game.player.y = game.curr_level->init_position.y;
-
-	game.player.spell_count = 0;
-	game.player.curr_spell  = SPELL_NONE;
+	reset_player(game);
+	printf("[Game] player Init\n");
 
+	game.particle_first = 0;
 	game.particle_count = 0;
 
 	game.has_focus = true;
@@ -99,49 +95,295 @@ init(Game& game)
 	return true;
 }
 
-internal Particle
-create_smoke_particle(int tex, const Vector3& position)
+// NOTE(bill): Frees the levels, the rest lives as long as the process
+void
+shutdown(Game& game)
 {
-	Particle p = {};
-	p.position = position;
+	destroy_level_manager(game.levels);
+	delete game.levels;
+	game.levels     = nullptr;
+	game.curr_level = nullptr;
+}
 
-	p.velocity.x = 0.2f * sinf(rand());
-	p.velocity.y = 0.2f * sinf(rand());
-	p.velocity.z = 0.2f * sinf(rand());
+// NOTE(bill): Needs `game.curr_level` to be set
+void
+reset_player(Game& game)
+{
+	game.player.fov   = 1.0f / (f32)SCREEN_HEIGHT;
+	game.player.z     = 0.1f;
+	game.player.pitch = -0.1f;
+	game.player.yaw   = -TAU / 4;
 
-	p.scale = {0.25f, 0.25f};
-	p.scale *= ((rand() % 8 - 4) / 16.0f + 1.0f);
-	p.tex  = tex;
-	p.life = 1.0f + (rand() % 8 - 4) / 64.0f;
+	game.player.max_health = game.player.health = 4.0f;
+	game.player.max_mana = game.player.mana = 20.0f;
+
+	game.player.x = game.curr_level->init_position.x;
+	game.player.y = game.curr_level->init_position.y;
 
-	return p;
+	game.player.spell_count = 0;
+	game.player.curr_spell  = SPELL_NONE;
+}
+
+// NOTE(bill): Only a pointer swap, so `level` must be ready already, see
+// `get_level`. The player starts again from its spawn point and nothing of
+// the old level carries over: its particles go, and `history` (what the next
+// frame blends from, when given) starts again on the new level.
+void
+switch_level(Game& game, Level* level, Tick_History* history)
+{
+	game.curr_level = level;
+	game.player.x   = level->init_position.x;
+	game.player.y   = level->init_position.y;
+
+	game.particle_count         = 0;
+	level->portal_cooldown_ends = game.tick; // NOTE(bill): Any cooldown was from an earlier visit
+
+	// NOTE(bill): Nothing on the level moved while the player was elsewhere,
+	// far entities have nothing to catch up on from before now
+	for (int i = 0; i < level->entity_count; i++)
+		level->entity_cold[i].updated_tick = game.tick;
+
+	if (history)
+		save_tick_history(game, history);
+}
+
+void
+seed_game_random(Game& game, u64 seed)
+{
+	game.rng          = random_series(seed, RANDOM_STREAM_GAMEPLAY);
+	game.particle_rng = random_series(seed, RANDOM_STREAM_PARTICLES);
+}
+
+// NOTE(bill): Most particles `spawn_particles` makes up in one go
+constexpr int MAX_SPAWN_BATCH = 64;
+
+// NOTE(bill): Straight into the free slots after the newest particle. The
+// random rolls for a batch are made up front, a row per component, and
+// turned into velocities and offsets with the batch kernels.
+internal void
+spawn_particles(Game& game, const Particle_Spawn& spawn, int count)
+{
+	Random_Series& rng = game.particle_rng;
+
+	if (count > MAX_PARTICLES - game.particle_count) // Don't add any more
+		count = MAX_PARTICLES - game.particle_count;
+	if (count <= 0)
+		return;
+
+	const int tex   = spawn.tex + (random_u32(rng) & 7);
+	const f32 speed = 0.2f * (spawn.speed > 0 ? spawn.speed : 1.0f);
+
+	f32 vx[MAX_SPAWN_BATCH], vy[MAX_SPAWN_BATCH], vz[MAX_SPAWN_BATCH];
+	f32 px[MAX_SPAWN_BATCH], py[MAX_SPAWN_BATCH], pz[MAX_SPAWN_BATCH];
+	f32 sizes[MAX_SPAWN_BATCH], lives[MAX_SPAWN_BATCH];
+
+	while (count > 0) {
+		const int n = count < MAX_SPAWN_BATCH ? count : MAX_SPAWN_BATCH;
+
+		random_units(rng, vx, n);
+		random_units(rng, vy, n);
+		random_units(rng, vz, n);
+		random_units(rng, sizes, n);
+		random_units(rng, lives, n);
+		batch_remap(vx, n, 2 * speed, spawn.velocity.x - speed);
+		batch_remap(vy, n, 2 * speed, spawn.velocity.y - speed);
+		batch_remap(vz, n, 2 * speed, spawn.velocity.z - speed);
+		if (spawn.z_spread > 0) {
+			random_units(rng, pz, n);
+			batch_remap(pz, n, 2 * spawn.z_spread, -spawn.z_spread);
+			for (int i = 0; i < n; i++)
+				vz[i] += pz[i];
+		}
+
+		if (spawn.jitter > 0) {
+			random_units(rng, px, n);
+			random_units(rng, py, n);
+			random_units(rng, pz, n);
+			batch_remap(px, n, 2 * spawn.jitter, spawn.position.x - spawn.jitter);
+			batch_remap(py, n, 2 * spawn.jitter, spawn.position.y - spawn.jitter);
+			batch_remap(pz, n, 2 * spawn.jitter, spawn.position.z - spawn.jitter);
+		} else {
+			for (int i = 0; i < n; i++) {
+				px[i] = spawn.position.x;
+				py[i] = spawn.position.y;
+				pz[i] = spawn.position.z;
+			}
+		}
+
+		for (int i = 0; i < n; i++) {
+			Particle& p = get_particle(game, game.particle_count + i);
+			p.position  = {px[i], py[i], pz[i]};
+			p.velocity  = {vx[i], vy[i], vz[i]};
+
+			const f32 size = 0.25f * (((s32)(8 * sizes[i]) - 4) / 16.0f + 1.0f);
+			p.scale        = {size, size};
+			p.tex          = tex;
+			p.expires      = start_cooldown(game.tick, 1.0f + ((s32)(8 * lives[i]) - 4) / 64.0f);
+		}
+
+		game.particle_count += n;
+		count -= n;
+	}
 }
 
 void
 play_sound(Mix_Chunk* s, f32 volume)
 {
+	if (s == nullptr) // NOTE(bill): Headless, nothing was loaded
+		return;
+
 	volume = clamp(volume, 0, 1);
 	// Mix_VolumeChunk(s, volume * MIX_MAX_VOLUME);
 	Mix_PlayChannel(-1, s, 0);
 }
 
+// NOTE(bill): The buffer only fills up if something goes very wrong, but pickups
+// and deaths must never be lost so handle what we have early instead
+void
+push_event(Game& game, const Game_Event& event)
+{
+	if (game.event_count == MAX_EVENTS)
+		process_events(game);
+
+	game.events[game.event_count++] = event;
+}
+
 internal void
-update_player(Game& game, f32 dt)
+push_sound(Game& game, Sound_Id sound)
 {
-	constexpr f32 MOVE_SPEED = 2.0f;
-	constexpr f32 YAW_SPEED  = 3.0f;
+	Game_Event event = {};
+	event.type       = EVENT_SOUND;
+	event.sound      = sound;
+	push_event(game, event);
+}
 
-	const u8* keys = game.keys;
-	auto& player   = game.player;
+internal void
+push_particle_burst(Game& game, int tex, int count, const Vector3& position, const Vector3& velocity, f32 z_spread)
+{
+	Game_Event event              = {};
+	event.type                    = EVENT_PARTICLE_BURST;
+	event.burst.spawn.position    = position;
+	event.burst.spawn.velocity    = velocity;
+	event.burst.spawn.tex         = tex;
+	event.burst.spawn.z_spread    = z_spread;
+	event.burst.count             = count;
+	push_event(game, event);
+}
 
-	if (keys[SDLK_LEFT])
-		player.yaw -= YAW_SPEED * dt;
-	if (keys[SDLK_RIGHT])
-		player.yaw += YAW_SPEED * dt;
+internal void
+push_entity_event(Game& game, Event_Type type, const Entity_Hot& e)
+{
+	Game_Event event      = {};
+	event.type            = type;
+	event.entity.type     = e.type;
+	event.entity.position = e.position;
+	push_event(game, event);
+}
+
+Camera
+make_camera(const Player& player, int width, int height)
+{
+	Camera camera   = {};
+	camera.position = player.position;
+	camera.pitch    = player.pitch;
+	camera.yaw      = player.yaw;
+	camera.cos_yaw  = cosf(player.yaw);
+	camera.sin_yaw  = sinf(player.yaw);
 
 	// NOTE(bill): No need to normalize as c^2 + s^2 = 1
-	const Vector2 forwards  = {sinf(player.yaw), cosf(player.yaw)};
-	const Vector2 sidewards = {cosf(player.yaw), -sinf(player.yaw)};
+	camera.forwards  = {camera.sin_yaw, camera.cos_yaw};
+	camera.sidewards = {camera.cos_yaw, -camera.sin_yaw};
+
+	camera.fov      = player.fov;
+	camera.inv_fov  = 1.0f / player.fov;
+	camera.width    = width;
+	camera.height   = height;
+	camera.x_center = 0.5f * width;
+	camera.y_center = (0.5f + player.pitch) * height;
+
+	camera.cone_slope = camera.x_center * camera.fov;
+	camera.cone_scale = 1.0f / sqrtf(1.0f + camera.cone_slope * camera.cone_slope);
+	return camera;
+}
+
+// NOTE(bill): Applies the mana regen for the ticks since the entity was last
+// updated, up to and including `tick`, in closed form. Entities beyond
+// `LOD_MID_DISTANCE` are only brought up to date through here and
+// `catch_up_entity_position`. Cooldowns are timestamps and need no catching
+// up, so types without regen are never written to.
+internal void
+catch_up_entity(Entity_Cold& c, Entity_Type type, u32 tick, f32 dt)
+{
+	const f32 mana_regen = get_archetype(type).mana_regen;
+	if (mana_regen <= 0)
+		return;
+	if ((s32)(tick - c.updated_tick) <= 0)
+		return;
+
+	const f32 elapsed = (f32)(tick - c.updated_tick) * dt;
+	c.updated_tick    = tick;
+	c.mana            = clamp(c.mana + mana_regen * elapsed, 0, c.max_mana);
+}
+
+// NOTE(bill): Walks an entity back from the far tier towards where the player
+// is now, as far as its `speed` would have taken it in `ticks` but no further
+// than `LOD_CATCH_UP_DISTANCE` or to within a tile of the player. It goes a
+// quarter tile at a time and stops short of the first wall; `handle_collisions`
+// settles it on the same tick. Wandering, fleeing and being slowed are not made
+// up for. Returns whether it moved.
+internal b32
+catch_up_entity_position(const Level& level, Entity_Hot& e, const Vector3& target, u32 ticks, f32 dt)
+{
+	constexpr f32 STEP = 0.25f;
+
+	const f32 speed = get_archetype(e.type).speed;
+	if (speed <= 0)
+		return false;
+
+	const Vector2 dpos = target.xy - e.position.xy;
+	const f32 distance = length(dpos);
+
+	f32 walk = speed * ticks * dt;
+	if (walk > LOD_CATCH_UP_DISTANCE)
+		walk = LOD_CATCH_UP_DISTANCE;
+	if (walk > distance - 1.0f)
+		walk = distance - 1.0f;
+
+	const int step_count = (int)(walk / STEP);
+	if (step_count <= 0)
+		return false;
+
+	const Vector2 step = (STEP / distance) * dpos;
+
+	int i = 0;
+	for (; i < step_count; i++) {
+		const Vector2 next = e.position.xy + step;
+		if (get_tile_type(level, (int)floorf(next.x + 0.5f), (int)floorf(next.y + 0.5f)) & TILE_WALL)
+			break;
+		e.position.xy = next;
+	}
+	return i > 0;
+}
+
+internal void
+turn_player(Game& game, f32 dt)
+{
+	constexpr f32 YAW_SPEED = 3.0f;
+
+	if (game.keys[SDLK_LEFT])
+		game.player.yaw -= YAW_SPEED * dt;
+	if (game.keys[SDLK_RIGHT])
+		game.player.yaw += YAW_SPEED * dt;
+}
+
+internal void
+update_player(Game& game, const Camera& camera, f32 dt)
+{
+	constexpr f32 MOVE_SPEED = 2.0f;
+
+	const u8* keys          = game.keys;
+	auto& player            = game.player;
+	const Vector2& forwards = camera.forwards;
 
 	if (keys[SDLK_UP]) {
 		player.x += MOVE_SPEED * forwards.x * dt;
@@ -155,31 +397,25 @@ update_player(Game& game, f32 dt)
 		player.steps -= 1;
 	}
 
-	player.z = 0.1f - 0.01 + 0.02f * abs(sinf(player.steps / 8.0f));
+	player.z = 0.1f - 0.01 + 0.02f * abs(fast_sin(player.steps / 8.0f));
 
 	// Health and Mana Regen
 	player.health += 1.0f * dt;
 	player.mana += 1.0f * dt;
-	player.new_spell_cooldown -= dt;
 
 	player.health = clamp(player.health, 0, player.max_health);
 	player.mana = clamp(player.mana, 0, player.max_mana);
-	if (player.new_spell_cooldown < 0)
-		player.new_spell_cooldown = 0;
 }
 
 internal void
-update_spells(Game& game, f32 dt)
+update_spells(Game& game, const Camera& camera, f32 dt)
 {
 	const u8* keys = game.keys;
 	auto& player   = game.player;
 	auto& level    = *game.curr_level;
 
-	// NOTE(bill): No need to normalize as c^2 + s^2 = 1
-	const Vector2 forwards  = {sinf(player.yaw), cosf(player.yaw)};
-	const Vector2 sidewards = {cosf(player.yaw), -sinf(player.yaw)};
-
-	player.spell_cooldown -= dt;
+	const Vector2& forwards  = camera.forwards;
+	const Vector2& sidewards = camera.sidewards;
 
 	if (keys[SDLK_1] && player.spell_count >= 1)
 		player.curr_spell = SPELL_FIRE;
@@ -192,58 +428,33 @@ update_spells(Game& game, f32 dt)
 
 	player.spell_active = false;
 	if (keys[SDLK_SPACE]) { // Use spells
-		f32 health_usage = 0;
-		f32 mana_usage = 0;
-		switch (player.curr_spell) {
-		case SPELL_FIRE: {
-			health_usage = 1.5;
-			mana_usage   = 5;
-		} break;
-
-		case SPELL_EARTH: {
-			health_usage = 0.5;
-			mana_usage   = 8;
-		} break;
+		const Spell_Info& spell = get_spell_info(player.curr_spell);
 
-		case SPELL_WATER: {
-			health_usage = 0.5;
-			mana_usage   = 7;
-		} break;
-
-		case SPELL_AIR: {
-			health_usage = 0.5;
-			mana_usage   = 7;
-		} break;
-
-		default:
-			break;
-		}
-
-		if (player.mana >= mana_usage * dt * 10 && mana_usage > 0 && player.spell_cooldown <= 0) {
+		const b32 ready = !is_cooling_down(player.spell_cooldown_ends, game.tick);
+		if (player.mana >= spell.mana_cost * dt * 10 && spell.mana_cost > 0 && ready) {
 			Vector3 pos = player.position;
 			pos.xy += forwards * dt;
 			pos.xy += 0.1f * sidewards;
 			pos.z   = 0.1f;
-			int tex = 0x10 * (player.curr_spell - 1);
-			tex += rand() & 7;
-			Particle p = create_smoke_particle(tex, pos);
-			p.velocity.xy += 3.0f * forwards;
-			add_particle(game, p);
+			push_particle_burst(game, spell.tex, 1, pos,
+			                    {3.0f * forwards.x, 3.0f * forwards.y, 0}, 0);
 
-			player.health -= health_usage * dt;
-			player.mana -= mana_usage * dt;
+			player.health -= spell.health_cost * dt;
+			player.mana -= spell.mana_cost * dt;
 
 			player.spell_active = true;
-			if (random(0, 1) < 0.2) {
-				play_sound(sound::fire);
-			}
+			if (random(game.rng, 0, 1) < 0.2)
+				push_sound(game, SOUND_FIRE);
 
 		} else {
 			player.spell_active = false;
 		}
 
-		if (player.mana <= 0)
-			player.spell_cooldown = 3.0f;
+		if (player.mana <= 0) {
+			if (!is_cooling_down(player.spell_cooldown_ends, game.tick))
+				add_timer(game.timers, start_cooldown(game.tick, 3.0f), TIMER_SPELL_READY);
+			player.spell_cooldown_ends = start_cooldown(game.tick, 3.0f);
+		}
 	}
 
 	if (player.spell_active) {
@@ -254,8 +465,9 @@ update_spells(Game& game, f32 dt)
 		} break;
 		}
 
+		const Spell_Info& spell = get_spell_info(player.curr_spell);
 		for (int i = 0; i < level.entity_count; i++) {
-			Entity& e = level.entities[i];
+			Entity_Hot& e = level.entity_hot[i];
 			if (!(e.type & ENTITY_MOB))
 				continue;
 
@@ -264,46 +476,188 @@ update_spells(Game& game, f32 dt)
 
 			if (distance > 6.0f)
 				continue;
+			if (!has_line_of_sight(level, player.position.xy, e.position.xy))
+				continue;
+			Entity_Cold& c      = level.entity_cold[i];
 			const f32 cos_theta = dot(dpos, forwards);
 
 			f32 affect = cos_theta / (distance * distance + 1.0f);
 
-			switch (player.curr_spell) {
+			e.position.xy += spell.push * forwards * affect * dt;
+			c.health -= spell.damage * affect * dt;
+			if (spell.earth_cooldown > 0 && !is_cooling_down(c.earth_cooldown_ends, game.tick))
+				c.earth_cooldown_ends = start_cooldown(game.tick, spell.earth_cooldown);
+			if (spell.water_cooldown > 0 && !is_cooling_down(c.water_cooldown_ends, game.tick))
+				c.water_cooldown_ends = start_cooldown(game.tick, spell.water_cooldown);
 
-			case SPELL_FIRE: {
-				e.position.xy += 10.0f * forwards * affect * dt;
-				e.health -= 10.0f * affect * dt;
-			} break;
+			if (e.type == ENTITY_BOSS) {
+				// printf("Boss: %f hp\n", c.health);
+			}
 
-			case SPELL_EARTH: {
-				e.position.xy += 5.0f * forwards * affect * dt;
-				e.health -= 5.0f * affect * dt;
-				if (e.earth_cooldown <= 0)
-					e.earth_cooldown = 2.0f;
-			} break;
+			if (c.health <= 0)
+				e.alive = false;
+		}
+	}
+}
 
-			case SPELL_WATER: {
-				e.position.xy += 8.0f * forwards * affect * dt;
-				e.health -= 7.0f * affect * dt;
+void
+save_sim_state(const Game& game, Sim_State* state)
+{
+	const Level& level = *game.curr_level;
 
-				if (e.water_cooldown <= 0)
-					e.water_cooldown = 3.0f;
+	state->tick         = game.tick;
+	state->sim_time     = game.sim_time;
+	state->rng          = game.rng;
+	state->particle_rng = game.particle_rng;
+
+	state->player                     = game.player;
+	state->has_finished               = game.has_finished;
+	state->killed_a_prisoner_cooldown_ends = game.killed_a_prisoner_cooldown_ends;
+	state->portal_cooldown_ends            = level.portal_cooldown_ends;
+	state->timers                          = game.timers;
+
+	if (state->entity_capacity < level.entity_count) {
+		state->entity_hot      = (Entity_Hot*)realloc(state->entity_hot, level.entity_count * sizeof(Entity_Hot));
+		state->entity_cold     = (Entity_Cold*)realloc(state->entity_cold, level.entity_count * sizeof(Entity_Cold));
+		state->entity_capacity = level.entity_count;
+	}
+	state->entity_count = level.entity_count;
+	memcpy(state->entity_hot, level.entity_hot, level.entity_count * sizeof(Entity_Hot));
+	memcpy(state->entity_cold, level.entity_cold, level.entity_count * sizeof(Entity_Cold));
+
+	state->particle_first = game.particle_first;
+	state->particle_count = game.particle_count;
+	for (int i = 0; i < game.particle_count; i++)
+		state->particles[i] = get_particle(game, i);
+}
 
-			} break;
+void
+load_sim_state(Game& game, const Sim_State& state)
+{
+	Level& level = *game.curr_level;
 
-			case SPELL_AIR: {
-				e.position.xy += 20.0f * forwards * affect * dt;
-				e.health -= 3.0f * affect * dt;
-			} break;
+	game.tick         = state.tick;
+	game.sim_time     = state.sim_time;
+	game.rng          = state.rng;
+	game.particle_rng = state.particle_rng;
+
+	game.player                     = state.player;
+	game.has_finished               = state.has_finished;
+	game.killed_a_prisoner_cooldown_ends = state.killed_a_prisoner_cooldown_ends;
+	level.portal_cooldown_ends           = state.portal_cooldown_ends;
+	game.timers                          = state.timers;
+
+	reserve_entities(level, state.entity_count);
+	level.entity_count = state.entity_count;
+	memcpy(level.entity_hot, state.entity_hot, state.entity_count * sizeof(Entity_Hot));
+	memcpy(level.entity_cold, state.entity_cold, state.entity_count * sizeof(Entity_Cold));
+	build_trigger_index(level);
+
+	game.particle_first = state.particle_first;
+	game.particle_count = state.particle_count;
+	for (int i = 0; i < state.particle_count; i++)
+		get_particle(game, i) = state.particles[i];
+}
 
-			default:
-				break;
-			}
+void
+destroy_sim_state(Sim_State* state)
+{
+	if (state) {
+		free(state->entity_hot);
+		free(state->entity_cold);
+		*state = {};
+	}
+}
 
-			if (e.type == ENTITY_BOSS) {
-				// printf("Boss: %f hp\n", e.health);
-			}
-		}
+void
+save_tick_history(const Game& game, Tick_History* history)
+{
+	const Level& level = *game.curr_level;
+
+	history->player = game.player;
+
+	if (history->entity_capacity < level.entity_count) {
+		history->entity_positions = (Vector3*)realloc(history->entity_positions, level.entity_count * sizeof(Vector3));
+		history->entity_capacity  = level.entity_count;
+	}
+	history->entity_count = level.entity_count;
+	for (int i = 0; i < level.entity_count; i++)
+		history->entity_positions[i] = level.entity_hot[i].position;
+
+	history->particle_first = game.particle_first;
+	history->particle_count = game.particle_count;
+	for (int i = 0; i < game.particle_count; i++) {
+		const u32 slot                     = (game.particle_first + i) & (MAX_PARTICLES - 1);
+		history->particle_positions[slot] = game.particles[slot].position;
+	}
+}
+
+// NOTE(bill): Whether the particle in ring `slot` now was also there when
+// `history` was saved. A slot is only handed out again once it is retired.
+internal b32
+had_particle(const Tick_History& history, u32 slot)
+{
+	return (int)((slot - history.particle_first) & (MAX_PARTICLES - 1)) < history.particle_count;
+}
+
+// NOTE(bill): Only valid while the entity count is unchanged since
+// `save_tick_history`, i.e. around a render
+void
+load_tick_history(Game& game, const Tick_History& history)
+{
+	Level& level = *game.curr_level;
+
+	game.player = history.player;
+	for (int i = 0; i < history.entity_count && i < level.entity_count; i++)
+		level.entity_hot[i].position = history.entity_positions[i];
+	for (int i = 0; i < game.particle_count; i++) {
+		const u32 slot = (game.particle_first + i) & (MAX_PARTICLES - 1);
+		if (had_particle(history, slot))
+			game.particles[slot].position = history.particle_positions[slot];
+	}
+}
+
+internal Vector3
+blend_position(const Vector3& prev, const Vector3& curr, f32 t)
+{
+	const Vector3 delta = curr - prev;
+	if (dot(delta, delta) > 1.0f) // NOTE(bill): Nothing moves a whole tile in a tick
+		return curr;
+	return prev + t * delta;
+}
+
+// NOTE(bill): Moves the game `t` of the way from `prev` to where it is now,
+// `t` being how far the wall clock is into the next tick
+void
+blend_tick_history(Game& game, const Tick_History& prev, f32 t)
+{
+	Level& level = *game.curr_level;
+
+	t = clamp(t, 0, 1);
+
+	game.player.position = blend_position(prev.player.position, game.player.position, t);
+	game.player.yaw      = lerp(prev.player.yaw, game.player.yaw, t);
+	game.player.pitch    = lerp(prev.player.pitch, game.player.pitch, t);
+
+	for (int i = 0; i < prev.entity_count && i < level.entity_count; i++) {
+		Entity_Hot& e = level.entity_hot[i];
+		e.position    = blend_position(prev.entity_positions[i], e.position, t);
+	}
+	for (int i = 0; i < game.particle_count; i++) {
+		const u32 slot = (game.particle_first + i) & (MAX_PARTICLES - 1);
+		if (!had_particle(prev, slot))
+			continue;
+		Particle& p = game.particles[slot];
+		p.position  = blend_position(prev.particle_positions[slot], p.position, t);
+	}
+}
+
+void
+destroy_tick_history(Tick_History* history)
+{
+	if (history) {
+		free(history->entity_positions);
+		*history = {};
 	}
 }
 
@@ -313,88 +667,317 @@ add_particle(Game& game, const Particle& particle)
 	if (game.particle_count == MAX_PARTICLES) // Don't add any more
 		return;
 
-	game.particles[game.particle_count] = particle;
+	get_particle(game, game.particle_count) = particle;
 	game.particle_count++;
 }
 
-internal void
-update_particles(Game& game, f32 dt)
+internal Mix_Chunk*
+get_sound(Sound_Id sound)
 {
-	for (int i = 0; i < game.particle_count; i++) {
-		Particle& p = game.particles[i];
-		p.life -= dt;
-		p.position += p.velocity * dt;
+	switch (sound) {
+	case SOUND_POWER_UP:
+		return sound::power_up;
+	case SOUND_HIT0:
+		return sound::hit0;
+	case SOUND_HIT1:
+		return sound::hit1;
+	case SOUND_FIRE:
+		return sound::fire;
+	default:
+		return nullptr;
 	}
+}
+
+// NOTE(bill): One pass per event type. Sounds are only collected here, see
+// `update_audio`, so the same sound queued many times is only played once.
+void
+process_events(Game& game)
+{
+	u32& sounds = game.pending_sounds;
 
-	for (int i = 0; i < game.particle_count;) {
-		Particle& p = game.particles[i];
-		if (p.life <= 0) {
-			game.particles[i] = game.particles[game.particle_count - 1];
-			game.particle_count--;
+	for (int i = 0; i < game.event_count; i++) {
+		const Game_Event& event = game.events[i];
+		if (event.type != EVENT_PICKUP)
 			continue;
+
+		switch (event.entity.type) {
+		case ENTITY_SCROLL: {
+			game.player.spell_count++;
+			game.player.curr_spell              = (Spell_Type)((int)(game.player.curr_spell) + 1);
+			game.player.new_spell_cooldown_ends = start_cooldown(game.tick, 3.0f);
+			game.player.max_health += 4;
+			game.player.max_mana += 4;
+		} break;
+		case ENTITY_HEALTH_POTION: {
+			game.player.health += 5;
+		} break;
+		case ENTITY_MANA_POTION: {
+			game.player.mana += 5;
+		} break;
+		default:
+			break;
 		}
-		i++;
+		sounds |= 1 << SOUND_POWER_UP;
 	}
 
-	Level& level       = *game.curr_level;
-	Vector3 player_pos = {game.player.x, game.player.y, game.player.z};
-	for (int i = 0; i < level.entity_count; i++) {
-
-		const Entity& e = level.entities[i];
-
-		Vector3 dpos  = player_pos - e.position;
-		Vector2 dside = normalize(Vector2{-dpos.y, dpos.x});
-		if (length(dpos) > 6.0f)
+	for (int i = 0; i < game.event_count; i++) {
+		const Game_Event& event = game.events[i];
+		if (event.type != EVENT_DEATH)
 			continue;
-		dpos = normalize(dpos);
 
-		switch (e.type) {
+		switch (event.entity.type) {
 		case ENTITY_MAGE: {
-			if ((rand() % 8) != 0)
-				continue;
-
-			Vector3 p_pos = e.position + 0.1f * dpos;
-			p_pos.xy += 0.3f * dside;
-			p_pos.z += 0.2f;
-			add_particle(game, create_smoke_particle(0x10 + (rand() & 7), p_pos));
+			if (!game.headless)
+				printf("Mage died\n");
 		} break;
 		case ENTITY_BOSS: {
-			if ((rand() % 8) != 0)
-				continue;
-			Vector3 p_pos = e.position + 0.1f * dpos;
-			p_pos.xy -= 0.3f * dside;
-			p_pos.z += 0.2f;
-			Particle p = create_smoke_particle(0x50 + (rand() & 7), p_pos);
-			p.velocity *= 2.0f;
-			add_particle(game, p);
+			game.has_finished = true;
 		} break;
-
-		case ENTITY_PORTAL: {
-			Vector3 pos = e.position;
-			pos.x += ((rand() & 15) / 32.0f) - 0.25f;
-			pos.y += ((rand() & 15) / 32.0f) - 0.25f;
-			pos.z += ((rand() & 15) / 32.0f) - 0.25f;
-			Particle p = create_smoke_particle(0x40 + (rand() & 7), pos);
-			p.velocity *= 3;
-			add_particle(game, p);
+		case ENTITY_PRISONER: {
+			game.killed_a_prisoner_cooldown_ends = start_cooldown(game.tick, 2.0f);
 		} break;
-
 		default:
 			break;
 		}
 	}
+
+	for (int i = 0; i < game.event_count; i++) {
+		const Game_Event& event = game.events[i];
+		if (event.type == EVENT_PARTICLE_BURST)
+			spawn_particles(game, event.burst.spawn, event.burst.count);
+	}
+
+	for (int i = 0; i < game.event_count; i++) {
+		const Game_Event& event = game.events[i];
+		if (event.type == EVENT_SOUND)
+			sounds |= 1 << event.sound;
+	}
+
+	game.event_count = 0;
+}
+
+// NOTE(bill): SDL_mixer is only called from here, on the main thread, never
+// from `update_game`
+void
+update_audio(Game& game)
+{
+	const u32 sounds    = game.pending_sounds;
+	game.pending_sounds = 0;
+	if (game.headless)
+		return;
+
+	if (music::main && !Mix_PlayingMusic())
+		Mix_PlayMusic(music::main, -1);
+
+	for (int i = 0; i < SOUND_COUNT; i++) {
+		if (sounds & (1 << i))
+			play_sound(get_sound((Sound_Id)i));
+	}
 }
 
+// NOTE(bill): Most emitters in view that get to emit in a tick, and how many
+// nearby ones are culled at once
+constexpr int MAX_ACTIVE_EMITTERS = 64;
+
 internal void
-render_particles(Game& game)
+emit_entity_particles(Game& game, int i, f32 dt)
 {
-	constexpr f32 radius     = 12.0f;
-	const Vector3 player_pos = {game.player.x, game.player.y, game.player.z};
+	Level& level        = *game.curr_level;
+	const Entity_Hot& e = level.entity_hot[i];
+	Entity_Cold& c      = level.entity_cold[i];
+
+	const Emitter_Def& def = ENTITY_EMITTERS[get_entity_id(e.type)];
+
+	c.emitted += def.rate * dt;
+	const int n = (int)c.emitted;
+	if (n <= 0)
+		return;
+	c.emitted -= n;
+
+	const Vector3 dpos  = normalize(game.player.position - e.position);
+	const Vector2 dside = normalize(Vector2{-dpos.y, dpos.x});
+
+	Particle_Spawn spawn = {};
+	spawn.position       = e.position + def.lead * dpos;
+	spawn.position.xy += def.side * dside;
+	spawn.position.z += def.height;
+	spawn.tex    = def.tex;
+	spawn.speed  = def.speed;
+	spawn.jitter = def.jitter;
+	spawn_particles(game, spawn, n);
+}
+
+// NOTE(bill): Entities with an emitter give off `rate` particles a second
+// while the player is within `EMITTER_RANGE`. Emitters outside the view cone
+// are skipped as a whole, nothing they make would be seen. Nearby emitters are
+// culled a batch at a time until the whole list has been scanned, so only
+// visible ones count towards `MAX_ACTIVE_EMITTERS`.
+internal void
+update_emitters(Game& game, const Camera& camera, f32 dt)
+{
+	Level& level             = *game.curr_level;
+	const Vector3 player_pos = game.player.position;
+
+	f32 x[MAX_ACTIVE_EMITTERS];
+	f32 y[MAX_ACTIVE_EMITTERS];
+	int entities[MAX_ACTIVE_EMITTERS];
+	int visible[MAX_ACTIVE_EMITTERS];
+
+	int active = 0;
+	int i      = 0;
+	while (i < level.entity_count && active < MAX_ACTIVE_EMITTERS) {
+		int count = 0;
+		for (; i < level.entity_count && count < MAX_ACTIVE_EMITTERS; i++) {
+			const Entity_Hot& e = level.entity_hot[i];
+			if (ENTITY_EMITTERS[get_entity_id(e.type)].rate <= 0)
+				continue;
+
+			const Vector3 dpos = player_pos - e.position;
+			if (dot(dpos, dpos) > EMITTER_RANGE * EMITTER_RANGE)
+				continue;
+
+			x[count]        = e.position.x;
+			y[count]        = e.position.y;
+			entities[count] = i;
+			count++;
+		}
+
+		const int visible_count = batch_view_cone(x, y, count, camera.position.xy,
+		                                          camera.forwards, camera.sidewards,
+		                                          camera.cone_slope, EMITTER_CULL_MARGIN, visible);
+		for (int j = 0; j < visible_count && active < MAX_ACTIVE_EMITTERS; j++, active++)
+			emit_entity_particles(game, entities[visible[j]], dt);
+	}
+}
+
+internal void
+update_particles(Game& game, const Camera& camera, f32 dt)
+{
+	// NOTE(bill): Particles are in spawn order and live about as long as each
+	// other, so the expired ones are (nearly) all at the front. One that
+	// expires a few ticks before an older one waits for it behind the head;
+	// `render_particles` skips it until then.
+	while (game.particle_count > 0 && !is_cooling_down(get_particle(game, 0).expires, game.tick)) {
+		game.particle_first++;
+		game.particle_count--;
+	}
+
 	for (int i = 0; i < game.particle_count; i++) {
-		const Particle& p = game.particles[i];
-		f32 d = length(p.position - player_pos);
-		if (d < radius)
-			render_sprite(game, art::particles, p.tex, p.position, p.scale);
+		Particle& p = get_particle(game, i);
+		p.position += p.velocity * dt;
+	}
+
+	update_emitters(game, camera, dt);
+}
+
+// NOTE(bill): Packed positions for the batch kernels while projecting sprites.
+// Only rendering uses it, so one is enough.
+struct Sprite_Batch {
+	int capacity;
+	f32* x;
+	f32* y;
+	f32* z;
+	int* indices;
+	int* cone_indices;
+	f32* view_x;
+	f32* view_z;
+};
+
+global Sprite_Batch sprite_batch;
+
+internal void
+reserve_sprite_batch(Sprite_Batch& batch, int count)
+{
+	if (batch.capacity >= count)
+		return;
+
+	batch.capacity = count > 2 * batch.capacity ? count : 2 * batch.capacity;
+	batch.x        = (f32*)realloc(batch.x, batch.capacity * sizeof(f32));
+	batch.y        = (f32*)realloc(batch.y, batch.capacity * sizeof(f32));
+	batch.z        = (f32*)realloc(batch.z, batch.capacity * sizeof(f32));
+	batch.indices  = (int*)realloc(batch.indices, batch.capacity * sizeof(int));
+	batch.cone_indices = (int*)realloc(batch.cone_indices, batch.capacity * sizeof(int));
+	batch.view_x   = (f32*)realloc(batch.view_x, batch.capacity * sizeof(f32));
+	batch.view_z   = (f32*)realloc(batch.view_z, batch.capacity * sizeof(f32));
+}
+
+// NOTE(bill): Takes the `count` positions gathered into the batch, keeps those
+// within `radius` of the player and inside the view cone (compacted, see
+// `indices`) and moves them into view space. `size` is the largest
+// half-width of the sprites. Returns how many were kept.
+internal int
+project_sprite_batch(const Camera& camera, Sprite_Batch& batch, int count, f32 radius, f32 size)
+{
+	const int near = batch_within(batch.x, batch.y, batch.z, count, camera.position, radius, batch.indices);
+	for (int i = 0; i < near; i++) {
+		const int index = batch.indices[i]; // NOTE(bill): Never less than i, safe in place
+		batch.x[i]      = batch.x[index];
+		batch.y[i]      = batch.y[index];
+		batch.z[i]      = batch.z[index];
+	}
+
+	const int visible = batch_view_cone(batch.x, batch.y, near, camera.position.xy,
+	                                    camera.forwards, camera.sidewards,
+	                                    camera.cone_slope, size, batch.cone_indices);
+	for (int i = 0; i < visible; i++) {
+		const int index  = batch.cone_indices[i];
+		batch.x[i]       = batch.x[index];
+		batch.y[i]       = batch.y[index];
+		batch.z[i]       = batch.z[index];
+		batch.indices[i] = batch.indices[index];
+	}
+
+	batch_view_transform(batch.x, batch.y, visible, camera.position.xy,
+	                     camera.cos_yaw, camera.sin_yaw,
+	                     batch.view_x, batch.view_z);
+	return visible;
+}
+
+internal void
+render_particles(Game& game, const Camera& camera)
+{
+	constexpr f32 radius = 12.0f;
+
+	// NOTE(bill): Oldest first so the draw order is stable from frame to frame
+	local_persist int slots[MAX_PARTICLES];
+
+	Sprite_Batch& batch = sprite_batch;
+	reserve_sprite_batch(batch, game.particle_count);
+	int count = 0;
+	for (int i = 0; i < game.particle_count; i++) {
+		const u32 slot    = (game.particle_first + i) & (MAX_PARTICLES - 1);
+		const Particle& p = game.particles[slot];
+		if (!is_cooling_down(p.expires, game.tick))
+			continue; // NOTE(bill): Expired, waiting behind an older particle
+
+		slots[count]   = slot;
+		batch.x[count] = p.position.x;
+		batch.y[count] = p.position.y;
+		batch.z[count] = p.position.z;
+		count++;
+	}
+
+	const int visible = project_sprite_batch(camera, batch, count, radius, 0.25f);
+	for (int i = 0; i < visible; i++) {
+		const Particle& p = game.particles[slots[batch.indices[i]]];
+		draw_sprite(game, camera, art::particles, p.tex,
+		            batch.view_x[i], 2 * (camera.position.z - batch.z[i]), batch.view_z[i], p.scale);
+	}
+}
+
+// NOTE(bill): One `render_sprite` per live particle, no batching or culling
+internal void
+render_particles_reference(Game& game, const Camera& camera)
+{
+	constexpr f32 radius = 12.0f;
+
+	for (int i = 0; i < game.particle_count; i++) {
+		const Particle& p = get_particle(game, i);
+		if (!is_cooling_down(p.expires, game.tick))
+			continue;
+
+		if (length(p.position - camera.position) < radius)
+			render_sprite(game, camera, art::particles, p.tex, p.position, p.scale);
 	}
 }
 
@@ -402,164 +985,304 @@ internal Entity
 get_portal_entity(Level& level, u16 portal_id)
 {
 	for (int i = 0; i < level.entity_count; i++) {
-		const Entity& e = level.entities[i];
-		if (e.type != ENTITY_PORTAL)
+		if (level.entity_hot[i].type != ENTITY_PORTAL)
 			continue;
-		if (e.portal_id == portal_id)
-			return e;
+		if (level.entity_cold[i].portal_id == portal_id)
+			return get_entity(level, i);
 	}
 
 	return {};
 }
 
+// NOTE(bill): What the per-type updates get, see `ENTITY_UPDATE_PROCS`
+struct Entity_Context {
+	Game* game;
+	Level* level;
+	Entity_Hot* hot;
+	Entity_Cold* cold;
+
+	Vector3 dpos; // NOTE(bill): Unit vector from the entity to the player
+	f32 distance;
+	f32 dt;
+	u32 ticks;       // NOTE(bill): How many ticks `dt` covers, more than 1 in the mid tier
+	b32 sees_player; // NOTE(bill): Only asked for when it has an attack
+};
+
 internal void
-update_entities(Game& game, Level& level, f32 dt)
+wander(Entity_Context& ctx, f32 speed)
 {
-	level.portal_cooldown -= dt;
-	if (level.portal_cooldown < 0)
-		level.portal_cooldown = 0;
-	game.killed_a_prisoner_cooldown -= dt;
-	if (game.killed_a_prisoner_cooldown < 0)
-		game.killed_a_prisoner_cooldown = 0;
+	Random_Series& rng = ctx.game->rng;
+	if ((random_u32(rng) & 31) < ctx.ticks) { // NOTE(bill): About 1 in 32 per tick
+		Vector2& velocity = ctx.cold->velocity;
+		velocity.x        = random(rng, -1, 1);
+		velocity.y        = random(rng, -1, 1);
+		velocity *= speed;
+	}
+}
 
-	const Vector2 forwards = {sinf(game.player.yaw), cosf(game.player.yaw)};
+// NOTE(bill): Returns whether the entity cast at the player this tick
+internal b32
+cast_at_player(Entity_Context& ctx, const Entity_Archetype& archetype)
+{
+	Game& game     = *ctx.game;
+	Entity_Cold& c = *ctx.cold;
 
-	for (int i = 0; i < level.entity_count; i++) {
-		Entity& e = level.entities[i];
-		e.earth_cooldown -= dt;
-		e.water_cooldown -= dt;
+	if (!(ctx.distance < archetype.attack_range &&
+	      random(game.rng, 0, 1) < archetype.attack_chance &&
+	      ctx.sees_player))
+		return false;
 
-		Vector3 dpos = game.player.position - e.position;
-		f32 distance = length(dpos);
-		if (distance > 8)
-			continue; // NOTE(bill): Don't update far things
-		dpos = normalize(dpos);
+	if (archetype.attack_mana > 0) {
+		c.mana -= archetype.attack_mana * ctx.dt;
+		if (c.mana <= 0)
+			return false;
+	}
 
-		switch (e.type) {
-		case ENTITY_MAGE: {
-			f32 speed = 2.0f;
-			if (e.earth_cooldown > 0)
-				speed *= 0.2f;
-			if (distance > 1.0f)
-				e.position += speed * dpos * dt;
-			if (e.water_cooldown > 0) {
-				if ((rand() & 31) == 0) {
-					e.velocity.x = random(-1, 1);
-					e.velocity.y = random(-1, 1);
-					e.velocity *= 3.0f;
-				}
-			}
+	Vector3 pos = ctx.hot->position;
+	pos.z       = 0.1f;
+	push_particle_burst(game, archetype.attack_tex, archetype.attack_particles,
+	                    pos, 10.0f * ctx.dpos, 0.5f);
+	f32 damage = random(game.rng, archetype.attack_damage_min, archetype.attack_damage_max) * ctx.dt;
+	game.player.health -= damage;
+	return true;
+}
 
-			if (distance < 10.0f && random(0, 1) < 0.1) {
-
-				Vector3 pos = e.position;
-				pos.z       = 0.1f;
-				int tex = 0x10; // GREEN!
-				tex += rand() & 7;
-				for (int i = 0; i < 3; i++) {
-					Particle p = create_smoke_particle(tex, pos);
-					p.velocity += 10.0f * dpos;
-					p.velocity.z += random(-0.5, 0.5);
-					add_particle(game, p);
-				}
-				f32 damage = random(3, 6) * dt;
-				game.player.health -= damage;
-			}
+// NOTE(bill): Returns whether the player went through
+internal b32
+touch_portal(Game& game, Level& level, const Entity_Cold& portal)
+{
+	if (is_cooling_down(level.portal_cooldown_ends, game.tick))
+		return false;
 
-		} break;
+	Entity other         = get_portal_entity(level, portal.connected_portal_id);
+	game.player.position = other.position;
+	push_sound(game, SOUND_FIRE); // TODO
 
-		case ENTITY_BOSS: {
-			if (distance < 1.0f)
-				e.position.xy -= 2.0f * dpos.xy * dt;
-			if ((rand() & 31) == 0) {
-				e.velocity.x = random(-1, 1);
-				e.velocity.y = random(-1, 1);
-				e.velocity *= 2.0f;
-			}
+	level.portal_cooldown_ends = start_cooldown(game.tick, 3.0f);
+	return true;
+}
 
-			if (e.water_cooldown > 0) {
-				if ((rand() & 31) == 0) {
-					e.velocity.x = random(-1, 1);
-					e.velocity.y = random(-1, 1);
-					e.velocity *= 2.0f;
-				}
-			}
+// NOTE(bill): Types without a specialisation do nothing every tick. Pickups
+// and portals are triggers, see `update_triggers`.
+template <Entity_Type Type>
+internal void
+update_entity(Entity_Context&)
+{
+}
+
+template <>
+void
+update_entity<ENTITY_MAGE>(Entity_Context& ctx)
+{
+	constexpr const Entity_Archetype& archetype = ENTITY_ARCHETYPES[get_entity_id(ENTITY_MAGE)];
+
+	Entity_Hot& e  = *ctx.hot;
+	Entity_Cold& c = *ctx.cold;
+
+	f32 speed = archetype.speed;
+	if (is_cooling_down(c.earth_cooldown_ends, ctx.game->tick))
+		speed *= 0.2f;
+	if (ctx.distance > 1.0f)
+		e.position += speed * ctx.dpos * ctx.dt;
+	if (is_cooling_down(c.water_cooldown_ends, ctx.game->tick))
+		wander(ctx, archetype.wander_speed);
+
+	cast_at_player(ctx, archetype); // GREEN!
+}
+
+template <>
+void
+update_entity<ENTITY_BOSS>(Entity_Context& ctx)
+{
+	constexpr const Entity_Archetype& archetype = ENTITY_ARCHETYPES[get_entity_id(ENTITY_BOSS)];
+
+	Game& game     = *ctx.game;
+	Entity_Hot& e  = *ctx.hot;
+	Entity_Cold& c = *ctx.cold;
+
+	if (ctx.distance < 1.0f)
+		e.position.xy -= archetype.flee_speed * ctx.dpos.xy * ctx.dt;
+	wander(ctx, archetype.wander_speed);
+	if (is_cooling_down(c.water_cooldown_ends, ctx.game->tick))
+		wander(ctx, archetype.wander_speed);
+
+	e.position.xy += c.velocity * ctx.dt;
+	e.position.xy += archetype.speed * ctx.dpos.xy * ctx.dt;
+
+	if (cast_at_player(ctx, archetype)) { // RED!
+		if (random(game.rng, 0, 1) < 0.2)
+			push_sound(game, (random_u32(game.rng) & 1) ? SOUND_HIT0 : SOUND_HIT1);
+	}
+
+	c.mana += archetype.mana_regen * ctx.dt;
+	c.mana = clamp(c.mana, 0, c.max_mana);
+}
+
+using Entity_Update_Proc = void (*)(Entity_Context& ctx);
+
+// NOTE(bill): Indexed by `get_entity_id`, same order as `ENTITY_ARCHETYPES`
+global const Entity_Update_Proc ENTITY_UPDATE_PROCS[ENTITY_ID_COUNT] = {
+    update_entity<ENTITY_NONE>,
+    update_entity<ENTITY_PORTAL>,
+    update_entity<ENTITY_SCROLL>,
+    update_entity<ENTITY_HEALTH_POTION>,
+    update_entity<ENTITY_MANA_POTION>,
+    update_entity<ENTITY_PRISONER>,
+    update_entity<ENTITY_PRISON_GUARD>,
+    update_entity<ENTITY_MAGE>,
+    update_entity<ENTITY_BOSS>,
+};
+
+// NOTE(bill): Only the triggers on the tiles around the player are looked at,
+// however many there are in the level
+internal void
+update_triggers(Game& game, Level& level)
+{
+	if (!has_trigger_index(level))
+		build_trigger_index(level);
+
+	const int px = (int)floorf(game.player.x + 0.5f);
+	const int py = (int)floorf(game.player.y + 0.5f);
+	for (int y = py - 1; y <= py + 1; y++) {
+		for (int x = px - 1; x <= px + 1; x++) {
+			for (int i = first_trigger(level, x, y); i >= 0; i = next_trigger(level, i)) {
+				Entity_Hot& e = level.entity_hot[i];
+				if (!e.alive || length(game.player.position - e.position) >= 0.5f)
+					continue;
 
-			e.position.xy += e.velocity * dt;
-			e.position.xy += 0.5f * dpos.xy * dt;
-
-			if (distance < 10.0f && random(0, 1) < 0.1) {
-				e.mana -= 1 * dt;
-				if (e.mana > 0) {
-					Vector3 pos = e.position;
-					pos.z       = 0.1f;
-					int tex = 0x50; // RED!
-					tex += rand() & 7;
-					for (int i = 0; i < 10; i++) {
-						Particle p = create_smoke_particle(tex, pos);
-						p.velocity += 10.0f * dpos;
-						p.velocity.z += random(-0.5, 0.5);
-						add_particle(game, p);
-					}
-					f32 damage = random(10, 15) * dt;
-					game.player.health -= damage;
-					if (random(0, 1) < 0.2) {
-						if (rand() & 1)
-							play_sound(sound::hit0);
-						else
-							play_sound(sound::hit1);
-					}
+				if (get_archetype(e.type).pickup) {
+					level.entity_cold[i].health = -1000; // KILL IT
+					e.alive                     = false;
+					push_entity_event(game, EVENT_PICKUP, e);
+				} else if (e.type == ENTITY_PORTAL) {
+					if (touch_portal(game, level, level.entity_cold[i]))
+						return; // NOTE(bill): Nothing else is near the player now
 				}
 			}
+		}
+	}
+}
 
-			e.mana += 2 * dt;
-			e.mana = clamp(e.mana, 0, e.max_mana);
+// NOTE(bill): Every trigger in the level, in entity order
+internal void
+update_triggers_reference(Game& game, Level& level)
+{
+	for (int i = 0; i < level.entity_count; i++) {
+		Entity_Hot& e = level.entity_hot[i];
+		if (!get_archetype(e.type).trigger)
+			continue;
+		if (!e.alive || length(game.player.position - e.position) >= 0.5f)
+			continue;
+
+		if (get_archetype(e.type).pickup) {
+			level.entity_cold[i].health = -1000; // KILL IT
+			e.alive                     = false;
+			push_entity_event(game, EVENT_PICKUP, e);
+		} else if (e.type == ENTITY_PORTAL) {
+			if (touch_portal(game, level, level.entity_cold[i]))
+				return;
 		}
+	}
+}
 
-		case ENTITY_PORTAL: {
-			if (distance < 0.5f && level.portal_cooldown <= 0) {
-				Entity portal        = get_portal_entity(level, e.connected_portal_id);
-				game.player.position = portal.position;
-				play_sound(sound::fire); // TODO
+internal void
+update_entities(Game& game, Level& level, f32 dt)
+{
+	// NOTE(bill): Near entities get the full update every tick. Mid range ones
+	// get it every `LOD_MID_INTERVAL` ticks with the time since, staggered by
+	// index so the load is flat. Far ones are not touched until they come
+	// closer, then `catch_up_entity` and `catch_up_entity_position` bring
+	// their mana and position up to date in closed form.
+	auto is_due = [&game](int i, f32 distance_2) -> b32 {
+		if (distance_2 <= LOD_NEAR_DISTANCE * LOD_NEAR_DISTANCE)
+			return true;
+		return distance_2 <= LOD_MID_DISTANCE * LOD_MID_DISTANCE &&
+		       ((game.tick + i) & (LOD_MID_INTERVAL - 1)) == 0;
+	};
+
+	// NOTE(bill): Casters only attack what they can see. Sight from every
+	// caster updating this tick to the player is asked for in one batch, from
+	// where they stand before anything moves.
+	constexpr int MAX_SIGHT_QUERIES = 64;
+	Sight_Query sight_queries[MAX_SIGHT_QUERIES];
+	b32 sight[MAX_SIGHT_QUERIES];
+	int sight_entities[MAX_SIGHT_QUERIES];
+	int sight_count = 0;
+	for (int i = 0; i < level.entity_count && sight_count < MAX_SIGHT_QUERIES; i++) {
+		const Entity_Hot& e = level.entity_hot[i];
+		if (get_archetype(e.type).attack_range <= 0)
+			continue;
 
-				level.portal_cooldown = 3.0f;
-			}
-		} break;
+		const Vector3 dpos = game.player.position - e.position;
+		if (!is_due(i, dot(dpos, dpos)))
+			continue;
 
-		case ENTITY_SCROLL: {
-			if (distance < 0.5f) {
-				e.health = -1000; // KILL IT
-				game.player.spell_count++;
-				game.player.curr_spell         = (Spell_Type)((int)(game.player.curr_spell) + 1);
-				game.player.new_spell_cooldown = 3.0f;
-				game.player.max_health += 4;
-				game.player.max_mana += 4;
-				play_sound(sound::power_up);
-			}
-			e.position.z = 0.05f * sinf(game.curr_time / 600.0f);
-		} break;
+		sight_queries[sight_count]  = {e.position.xy, game.player.position.xy};
+		sight_entities[sight_count] = i;
+		sight_count++;
+	}
+	test_line_of_sight(level, sight_queries, sight_count, sight);
+	int next_sight = 0;
+
+	// NOTE(bill): Falls back to a single query for anything the batch missed
+	auto can_see_player = [&](int i, const Entity_Hot& e) -> b32 {
+		while (next_sight < sight_count && sight_entities[next_sight] < i)
+			next_sight++;
+		if (next_sight < sight_count && sight_entities[next_sight] == i)
+			return sight[next_sight];
+		return has_line_of_sight(level, e.position.xy, game.player.position.xy);
+	};
 
-		case ENTITY_HEALTH_POTION: {
-			e.position.z = 0.05f * sinf(game.curr_time / 600.0f);
-			if (distance < 0.5f) {
-				e.health = -1000; // KILL IT
-				game.player.health += 5;
-				play_sound(sound::power_up);
-			}
-		} break;
+	for (int i = 0; i < level.entity_count; i++) {
+		Entity_Hot& e = level.entity_hot[i];
+		if (get_archetype(e.type).trigger)
+			continue;
 
-		case ENTITY_MANA_POTION: {
-			e.position.z = 0.05f * sinf(game.curr_time / 600.0f);
-			if (distance < 0.5f) {
-				e.health = -1000; // KILL IT
-				game.player.mana += 5;
-				play_sound(sound::power_up);
-			}
-		} break;
+		Vector3 dpos   = game.player.position - e.position;
+		f32 distance_2 = dot(dpos, dpos);
+		if (!is_due(i, distance_2))
+			continue;
 
-		default:
-			break;
+		// NOTE(bill): A mid range update covers the ticks since the last one,
+		// up to `LOD_MID_INTERVAL` of them. Anything before that it spent far
+		// away and is caught up on here.
+		Entity_Cold& c = level.entity_cold[i];
+		u32 ticks      = 1;
+		if (distance_2 > LOD_NEAR_DISTANCE * LOD_NEAR_DISTANCE) {
+			ticks = game.tick - c.updated_tick;
+			if (ticks == 0 || ticks > LOD_MID_INTERVAL)
+				ticks = LOD_MID_INTERVAL;
 		}
+
+		b32 moved           = false;
+		const u32 far_ticks = game.tick - ticks - c.updated_tick;
+		if ((s32)far_ticks > 0 && catch_up_entity_position(level, e, game.player.position, far_ticks, dt)) {
+			moved      = true;
+			dpos       = game.player.position - e.position;
+			distance_2 = dot(dpos, dpos);
+		}
+		catch_up_entity(c, e.type, game.tick - ticks, dt);
+		c.updated_tick = game.tick;
+
+		// NOTE(bill): The batch saw from where it stood before catching up
+		b32 sees_player = false;
+		if (get_archetype(e.type).attack_range > 0)
+			sees_player = moved ? has_line_of_sight(level, e.position.xy, game.player.position.xy) : can_see_player(i, e);
+
+		Entity_Context ctx = {};
+		ctx.game           = &game;
+		ctx.level          = &level;
+		ctx.hot            = &e;
+		ctx.cold           = &c;
+		ctx.dpos           = normalize(dpos);
+		ctx.distance       = sqrtf(distance_2);
+		ctx.dt             = ticks * dt;
+		ctx.ticks          = ticks;
+		ctx.sees_player    = sees_player;
+		ENTITY_UPDATE_PROCS[get_entity_id(e.type)](ctx);
+
+		if (c.health <= 0)
+			e.alive = false;
 	}
 }
 
@@ -567,29 +1290,74 @@ internal void
 remove_dead_entities(Game& game, Level& level)
 {
 	for (int i = 0; i < level.entity_count;) {
-		if (level.entities[i].health <= 0) {
-			const Entity& e = level.entities[i];
-			if (e.type == ENTITY_MAGE)
-				printf("Mage died\n");
-			if (e.type == ENTITY_BOSS)
-				game.has_finished = true;
-			if (e.type == ENTITY_PRISONER)
-				game.killed_a_prisoner_cooldown = 2.0f;
-			if (i != level.entity_count - 1)
-				level.entities[i] = level.entities[level.entity_count - 1];
-			level.entity_count--;
+		if (!level.entity_hot[i].alive) {
+			push_entity_event(game, EVENT_DEATH, level.entity_hot[i]);
+			remove_entity(level, i);
 			continue;
 		}
 		i++;
 	}
 }
 
+// NOTE(bill): Only touches the timer when `game.timings` is set
+#define TIMED_CALL(game, name, call) \
+	do { \
+		if ((game).timings) { \
+			const f64 timed_call_start_ = emscripten_get_now(); \
+			call; \
+			(game).timings->name += emscripten_get_now() - timed_call_start_; \
+		} else { \
+			call; \
+		} \
+	} while (0)
+
+internal void
+on_spell_ready(Game& game, const Timer&)
+{
+	// NOTE(bill): Running out of mana again pushes the cooldown back
+	const u32 ends = game.player.spell_cooldown_ends;
+	if (is_cooling_down(ends, game.tick)) {
+		add_timer(game.timers, ends, TIMER_SPELL_READY);
+		return;
+	}
+
+	push_sound(game, SOUND_POWER_UP);
+}
+
+using Timer_Proc = void (*)(Game& game, const Timer& timer);
+
+// NOTE(bill): Indexed by `Timer_Type`
+global const Timer_Proc TIMER_PROCS[] = {
+    on_spell_ready,
+};
+
+internal void
+process_timers(Game& game)
+{
+	advance_timer_wheel(game.timers, game.tick, [&game](const Timer& timer) {
+		TIMER_PROCS[timer.type](game, timer);
+	});
+}
+
+global const Sim_Procs SIM_PROCS_REFERENCE = {
+    update_particles,
+    update_entities,
+    update_triggers_reference,
+    handle_collisions_reference,
+};
+
+global const Sim_Procs SIM_PROCS = {
+    update_particles,
+    update_entities,
+    update_triggers,
+    handle_collisions,
+};
+
 void
 update_game(Game& game, f32 dt)
 {
-	if (!Mix_PlayingMusic()) {
-		Mix_PlayMusic(music::main, -1);
-	}
+	game.tick++;
+	game.sim_time += dt;
 
 	if (game.player.health <= 0)
 		game.has_finished = true;
@@ -597,15 +1365,25 @@ update_game(Game& game, f32 dt)
 		return;
 
 	Level& level = *game.curr_level;
+	update_level_pager(level, game.player.position.xy, game.tick);
+
+	process_timers(game);
+
+	turn_player(game, dt);
+	const Camera camera = make_camera(game.player, SCREEN_WIDTH, SCREEN_HEIGHT);
 
-	update_player(game, dt);
-	update_spells(game, dt);
-	update_particles(game, dt);
-	update_entities(game, level, dt);
+	update_player(game, camera, dt);
+	update_spells(game, camera, dt);
+	const Sim_Procs& procs = game.procs ? *game.procs : SIM_PROCS;
+	TIMED_CALL(game, update_particles, procs.update_particles(game, camera, dt));
+	TIMED_CALL(game, update_entities, procs.update_entities(game, level, dt));
+	procs.update_triggers(game, level);
 
-	remove_dead_entities(game, level);
+	TIMED_CALL(game, remove_dead_entities, remove_dead_entities(game, level));
 
-	handle_collisions(game, dt);
+	TIMED_CALL(game, handle_collisions, procs.handle_collisions(game, dt));
+
+	process_events(game);
 }
 
 internal Vector2
@@ -656,8 +1434,7 @@ check_collision(const Level& level, Rect rect)
 
 	for (int y = y_center - radius; y <= y_center + radius; y++) {
 		for (int x = x_center - radius; x <= x_center + radius; x++) {
-			Tile t = get_tile(level, x, y);
-			if (!(t.type & TILE_WALL))
+			if (!(get_tile_type(level, x, y) & TILE_WALL))
 				continue;
 
 			Rect tile_rect = {x, y, 1, 1};
@@ -676,8 +1453,23 @@ entity_rect(const Vector2& pos)
 	return {pos.x + 0.3f, pos.y + 0.3f, 0.4f, 0.4f};
 }
 
+// NOTE(bill): If the player goes off the map, go to the spawn
+internal void
+keep_player_in_level(Game& game, const Level& level)
+{
+	if (game.player.x < 0 || game.player.y < 0 ||
+	    game.player.x >= level.width || game.player.y >= level.height) {
+		game.player.x = level.init_position.x;
+		game.player.y = level.init_position.y;
+		if (!game.headless) {
+			printf("[ERROR] Player when out of bounds\n");
+			printf("Player is has been teleported to the beginning");
+		}
+	}
+}
+
 void
-handle_collisions(Game& game, f32 dt)
+handle_collisions(Game& game, f32)
 {
 	Level& level = *game.curr_level;
 
@@ -685,21 +1477,40 @@ handle_collisions(Game& game, f32 dt)
 	player_pos.xy += check_collision(level, entity_rect(player_pos.xy));
 
 	for (int i = 0; i < level.entity_count; i++) {
-		Entity& e = level.entities[i];
+		Entity_Hot& e = level.entity_hot[i];
 
-		if (length(e.position - player_pos) > 6)
+		// NOTE(bill): Triggers stand on the middle of a floor tile, which no
+		// wall ever overlaps
+		if (get_archetype(e.type).trigger)
+			continue;
+		if (length(e.position - player_pos) > LOD_MID_DISTANCE)
 			continue;
 		e.position.xy += check_collision(level, entity_rect(e.position.xy));
 	}
 
-	// NOTE(bill): If the player goes off the map, go to the spawn
-	if (game.player.x < 0 || game.player.y < 0 ||
-	    game.player.x >= level.width || game.player.y >= level.height) {
-		game.player.x = level.init_position.x;
-		game.player.y = level.init_position.y;
-		printf("[ERROR] Player when out of bounds\n");
-		printf("Player is has been teleported to the beginning");
+	keep_player_in_level(game, level);
+}
+
+// NOTE(bill): `handle_collisions` without the trigger skip, which is the only
+// optimisation sim_check compares here. Every entity near the player, triggers
+// included.
+void
+handle_collisions_reference(Game& game, f32)
+{
+	Level& level = *game.curr_level;
+
+	Vector3& player_pos = game.player.position;
+	player_pos.xy += check_collision(level, entity_rect(player_pos.xy));
+
+	for (int i = 0; i < level.entity_count; i++) {
+		Entity_Hot& e = level.entity_hot[i];
+
+		if (length(e.position - player_pos) > LOD_MID_DISTANCE)
+			continue;
+		e.position.xy += check_collision(level, entity_rect(e.position.xy));
 	}
+
+	keep_player_in_level(game, level);
 }
 
 void
@@ -712,45 +1523,50 @@ clear_buffers(Framebuffer& display, Color clear_color)
 }
 
 void
-render_entities(Game& game)
+render_entities(Game& game, const Camera& camera)
 {
-	f32 radius         = 6.0f;
-	Vector3 player_pos = {game.player.x, game.player.y, game.player.z};
-	Level& level       = *game.curr_level;
+	constexpr f32 radius = 6.0f;
+	Level& level         = *game.curr_level;
+
+	const f32 bob = 0.05f * fast_sin(game.sim_time / 0.6);
 
+	Sprite_Batch& batch = sprite_batch;
+	reserve_sprite_batch(batch, level.entity_count);
 	for (int i = 0; i < level.entity_count; i++) {
-		const Entity& e = level.entities[i];
+		const Entity_Hot& e = level.entity_hot[i];
+		batch.x[i]          = e.position.x;
+		batch.y[i]          = e.position.y;
+		batch.z[i]          = e.position.z + (get_archetype(e.type).bobs ? bob : 0);
+	}
 
-		if (length(e.position - player_pos) > radius)
-			continue;
+	const int visible = project_sprite_batch(camera, batch, level.entity_count, radius, 0.5f);
+	for (int i = 0; i < visible; i++) {
+		const Entity_Hot& e = level.entity_hot[batch.indices[i]];
 
-		int tex = 0;
-		switch (e.type) {
-		case ENTITY_PORTAL:
-			tex = 0x00;
-			break;
-		case ENTITY_MAGE:
-			tex = 0x10;
-			break;
-		case ENTITY_PRISONER:
-			tex = 0x20;
-			break;
-		case ENTITY_SCROLL:
-			tex = 0x30;
-			break;
-		case ENTITY_BOSS:
-			tex = 0x40;
-			break;
-		case ENTITY_HEALTH_POTION:
-			tex = 0x31;
-			break;
-		case ENTITY_MANA_POTION:
-			tex = 0x32;
-			break;
-		default:
-			break;
-		}
-		render_sprite(game, art::sprites, tex, e.position);
+		const int tex = get_archetype(e.type).tex;
+		draw_sprite(game, camera, art::sprites, tex,
+		            batch.view_x[i], 2 * (camera.position.z - batch.z[i]), batch.view_z[i]);
+	}
+}
+
+internal void
+render_entities_reference(Game& game, const Camera& camera)
+{
+	constexpr f32 radius = 6.0f;
+	Level& level         = *game.curr_level;
+
+	const f32 bob = 0.05f * fast_sin(game.sim_time / 0.6);
+
+	for (int i = 0; i < level.entity_count; i++) {
+		const Entity_Hot& e = level.entity_hot[i];
+		const Entity_Archetype& archetype = get_archetype(e.type);
+
+		Vector3 position = e.position;
+		if (archetype.bobs)
+			position.z += bob;
+
+		if (length(position - camera.position) < radius)
+			render_sprite(game, camera, art::sprites, archetype.tex, position);
 	}
 }
 
@@ -792,12 +1608,99 @@ get_wall_tex(Tile_Type t, int offset)
 	}
 }
 
+// NOTE(bill): Walls are drawn from the middle of the player's tile, see
+// `render_wall`
+inline Vector2
+get_wall_eye(const Camera& camera)
+{
+	return camera.position.xy + Vector2{0.5f, 0.5f};
+}
+
+// NOTE(bill): Conservative, false only if all of the circle is outside the cone
+internal b32
+circle_in_view(const Camera& camera, const Vector2& eye, const Vector2& center, f32 radius)
+{
+	const Vector2 d  = center - eye;
+	const f32 depth  = dot(d, camera.forwards);
+	const f32 side   = abs(dot(d, camera.sidewards));
+	const f32 beyond = (side - depth * camera.cone_slope) * camera.cone_scale;
+	return depth > -radius && beyond < radius;
+}
+
+// NOTE(bill): Conservative, false only if the segment is behind the camera or
+// wholly past one edge of the cone
+internal b32
+segment_in_view(const Camera& camera, const Vector2& eye, const Vector2& p0, const Vector2& p1)
+{
+	constexpr f32 DEPTH_CLIP = 0.0005f; // NOTE(bill): Half of `render_wall`s, it works in double units
+
+	const Vector2 d0 = p0 - eye;
+	const Vector2 d1 = p1 - eye;
+	const f32 z0     = dot(d0, camera.forwards);
+	const f32 z1     = dot(d1, camera.forwards);
+	const f32 x0     = dot(d0, camera.sidewards);
+	const f32 x1     = dot(d1, camera.sidewards);
+
+	if (z0 < DEPTH_CLIP && z1 < DEPTH_CLIP)
+		return false;
+	if (x0 > z0 * camera.cone_slope && x1 > z1 * camera.cone_slope)
+		return false;
+	if (x0 < -z0 * camera.cone_slope && x1 < -z1 * camera.cone_slope)
+		return false;
+	return true;
+}
+
+internal void
+render_walls(Game& game, const Camera& camera, Level& level)
+{
+	int radius   = 6;
+	int x_center = (int)camera.position.x;
+	int y_center = (int)camera.position.y;
+
+	const Vector2 eye = get_wall_eye(camera);
+
+	for (int y = y_center - radius; y <= y_center + radius; y++) {
+		for (int x = x_center - radius; x <= x_center + radius; x++) {
+			if (!circle_in_view(camera, eye, {x + 0.5f, y + 0.5f}, 0.5f * SQRT_2))
+				continue;
+
+			const Tile_Type center = get_tile_type(level, x, y);
+			const Tile_Type east   = get_tile_type(level, x + 1, y);
+			const Tile_Type west   = get_tile_type(level, x - 1, y);
+			const Tile_Type north  = get_tile_type(level, x, y - 1);
+			const Tile_Type south  = get_tile_type(level, x, y + 1);
+
+			if (center == TILE_FLOOR || center == TILE_FALSE_WALL) {
+				const int offset = (((x + 1) * (y + 1)) + x * 7 + y * 6 - 7) & 31;
+				// NOTE(bill): A face is only seen from the floor side, i.e. when
+				// the eye is on this tile's side of its plane
+				if (east != TILE_FLOOR && eye.x < x + 1 &&
+				    segment_in_view(camera, eye, {x + 1, y + 1}, {x + 1, y}))
+					render_wall(game, camera, get_wall_tex(east, offset), {x + 1, y + 1}, {x + 1, y});
+
+				if (west != TILE_FLOOR && eye.x > x &&
+				    segment_in_view(camera, eye, {x, y}, {x, y + 1}))
+					render_wall(game, camera, get_wall_tex(west, offset), {x, y}, {x, y + 1});
+
+				if (north != TILE_FLOOR && eye.y > y &&
+				    segment_in_view(camera, eye, {x + 1, y}, {x, y}))
+					render_wall(game, camera, get_wall_tex(north, offset), {x + 1, y}, {x, y});
+
+				if (south != TILE_FLOOR && eye.y < y + 1 &&
+				    segment_in_view(camera, eye, {x, y + 1}, {x + 1, y + 1}))
+					render_wall(game, camera, get_wall_tex(south, offset), {x, y + 1}, {x + 1, y + 1});
+			}
+		}
+	}
+}
+
+// NOTE(bill): Every face in range, without the view cone or facing tests
 internal void
-render_walls(Game& game, Level& level)
+render_walls_reference(Game& game, const Camera& camera, Level& level)
 {
 	int radius   = 6;
-	int x_center = (int)game.player.x;
-	int y_center = (int)game.player.y;
+	int x_center = (int)camera.position.x;
+	int y_center = (int)camera.position.y;
 
 	for (int y = y_center - radius; y <= y_center + radius; y++) {
 		for (int x = x_center - radius; x <= x_center + radius; x++) {
@@ -810,32 +1713,52 @@ render_walls(Game& game, Level& level)
 			if (center.type == TILE_FLOOR || center.type == TILE_FALSE_WALL) {
 				const int offset = (((x + 1) * (y + 1)) + x * 7 + y * 6 - 7) & 31;
 				if (east.type != TILE_FLOOR)
-					render_wall(game, get_wall_tex(east.type, offset), {x + 1, y + 1}, {x + 1, y});
+					render_wall(game, camera, get_wall_tex(east.type, offset), {x + 1, y + 1}, {x + 1, y});
 
 				if (west.type != TILE_FLOOR)
-					render_wall(game, get_wall_tex(west.type, offset), {x, y}, {x, y + 1});
+					render_wall(game, camera, get_wall_tex(west.type, offset), {x, y}, {x, y + 1});
 
 				if (north.type != TILE_FLOOR)
-					render_wall(game, get_wall_tex(north.type, offset), {x + 1, y}, {x, y});
+					render_wall(game, camera, get_wall_tex(north.type, offset), {x + 1, y}, {x, y});
 
 				if (south.type != TILE_FLOOR)
-					render_wall(game, get_wall_tex(south.type, offset), {x, y + 1}, {x + 1, y + 1});
+					render_wall(game, camera, get_wall_tex(south.type, offset), {x, y + 1}, {x + 1, y + 1});
 			}
 		}
 	}
 }
 
+// NOTE(bill): `render_floors` and `apply_post_fx` only have the one version so far
+global const Render_Procs RENDER_PROCS_REFERENCE = {
+    render_floors,
+    render_walls_reference,
+    render_entities_reference,
+    render_particles_reference,
+    apply_post_fx,
+};
+
+global const Render_Procs RENDER_PROCS = {
+    render_floors,
+    render_walls,
+    render_entities,
+    render_particles,
+    apply_post_fx,
+};
+
 void
-render_level(Game& game)
+render_level(Game& game, const Camera& camera, f32 fog_strength)
 {
 	Level& level = *game.curr_level;
+	const Render_Procs& procs = game.render_procs ? *game.render_procs : RENDER_PROCS;
 
-	render_floors(game, true);
-	render_walls(game, level);
+	procs.render_floors(game, camera, true);
+	procs.render_walls(game, camera, level);
 
-	render_entities(game);
+	procs.render_entities(game, camera);
 
-	render_particles(game);
+	procs.render_particles(game, camera);
+
+	procs.apply_post_fx(game.display, fog_strength);
 }
 
 internal void
@@ -938,7 +1861,7 @@ render_ui(Game& game)
 		render_ui_sprite(game.display, art::sprites, {93, 80},
 		                 {48, 192 + (game.player.curr_spell == SPELL_AIR ? 16 : 0), 8, 8});
 
-	if (game.player.new_spell_cooldown > 0) {
+	if (is_cooling_down(game.player.new_spell_cooldown_ends, game.tick)) {
 		local_persist char spell_buffer[256] = {0};
 		const char* spell_name               = "Ignis Flamma";
 		Color spell_color = {200, 150, 0, 255};
@@ -963,7 +1886,7 @@ render_ui(Game& game)
 		render_text(game, spell_buffer, {xx, yy}, spell_color);
 	}
 
-	if (game.killed_a_prisoner_cooldown) {
+	if (is_cooling_down(game.killed_a_prisoner_cooldown_ends, game.tick)) {
 		int xx1 = (game.display.width - (12 * CHAR_WIDTH)) / 2;
 		render_text(game, "You monster!", {xx1, 19}, WHITE);
 	}
@@ -995,28 +1918,28 @@ render_ui(Game& game)
 }
 
 void
-render_floors(Game& game, b32 draw_ceiling)
-{
-	const int width    = game.display.width;
-	const int height   = game.display.height;
-	const f32 x_center = 0.5f * width;
-	const f32 y_center = (0.5f + game.player.pitch) * height;
-	const f32 cos_yaw  = cosf(game.player.yaw);
-	const f32 sin_yaw  = sinf(game.player.yaw);
+render_floors(Game& game, const Camera& camera, b32 draw_ceiling)
+{
+	const int width    = camera.width;
+	const int height   = camera.height;
+	const f32 x_center = camera.x_center;
+	const f32 y_center = camera.y_center;
+	const f32 cos_yaw  = camera.cos_yaw;
+	const f32 sin_yaw  = camera.sin_yaw;
 	const Level& level = *game.curr_level;
 
 	Color* row = (Color*)game.display.pixels - game.display.width;
 	for (u32 y = 0; y < height; y++) {
 		row += game.display.width; // NOTE(bill): preincrement row - not need for defer
-		const f32 dy = ((y + 0.5f) - y_center) * game.player.fov;
+		const f32 dy = ((y + 0.5f) - y_center) * camera.fov;
 
 		f32 dd = 0;
 
 		b32 ceiling_mode = false;
 		if (dy > 0) { // NOTE(bill): Render Floor
-			dd = TILE_SIZE * (game.player.z + 0.5f) / dy;
+			dd = TILE_SIZE * (camera.position.z + 0.5f) / dy;
 		} else { // NOTE(bill): Render Ceiling
-			dd = TILE_SIZE * (game.player.z - 0.5f) / dy;
+			dd = TILE_SIZE * (camera.position.z - 0.5f) / dy;
 
 			ceiling_mode = true;
 		}
@@ -1026,11 +1949,11 @@ render_floors(Game& game, b32 draw_ceiling)
 			if (game.display.depth_buffer[x + y * width] > depth)
 				continue;
 
-			const f32 dx = dd * (x - x_center) * game.player.fov;
+			const f32 dx = dd * (x - x_center) * camera.fov;
 
 			// NOTE(bill): 0.5f is to center player
-			const f32 xx = (dx * cos_yaw + dd * sin_yaw) + ((game.player.x + 0.5f) * TILE_SIZE);
-			const f32 yy = (dd * cos_yaw - dx * sin_yaw) + ((game.player.y + 0.5f) * TILE_SIZE);
+			const f32 xx = (dx * cos_yaw + dd * sin_yaw) + ((camera.position.x + 0.5f) * TILE_SIZE);
+			const f32 yy = (dd * cos_yaw - dx * sin_yaw) + ((camera.position.y + 0.5f) * TILE_SIZE);
 
 			int xp = xx;
 			int yp = yy;
@@ -1049,7 +1972,7 @@ render_floors(Game& game, b32 draw_ceiling)
 
 			if (xtile >= 0 && ytile >= 0 &&
 			    xtile < level.width && ytile < level.height) {
-				Tile tile = level.grid[xtile + ytile * level.width];
+				const Tile tile = get_tile(level, xtile, ytile); // NOTE(bill): The grid or a chunk
 				if (tile.type != TILE_FLOOR && tile.type != TILE_BARS) {
 					continue;
 				}
@@ -1075,33 +1998,33 @@ render_floors(Game& game, b32 draw_ceiling)
 }
 
 void
-render_wall(Game& game, int tex, const Vector2& p0, const Vector2& p1)
+render_wall(Game& game, const Camera& camera, int tex, const Vector2& p0, const Vector2& p1)
 {
-	const int width     = game.display.width;
-	const int height    = game.display.height;
-	const f32 x_center  = 0.5f * width;
-	const f32 y_center  = (0.5f + game.player.pitch) * height;
-	const f32 cos_theta = cosf(game.player.yaw);
-	const f32 sin_theta = sinf(game.player.yaw);
+	const int width     = camera.width;
+	const int height    = camera.height;
+	const f32 x_center  = camera.x_center;
+	const f32 y_center  = camera.y_center;
+	const f32 cos_theta = camera.cos_yaw;
+	const f32 sin_theta = camera.sin_yaw;
 
 	////////////////
 
 	// NOTE(bill): -1.0f is to center player
-	const f32 xc0 = 2 * (p0.x - game.player.x) - 1.0f;
-	const f32 yc0 = 2 * (p0.y - game.player.y) - 1.0f;
+	const f32 xc0 = 2 * (p0.x - camera.position.x) - 1.0f;
+	const f32 yc0 = 2 * (p0.y - camera.position.y) - 1.0f;
 
 	f32 xx0 = xc0 * cos_theta - yc0 * sin_theta;
-	f32 u0  = 2 * game.player.z - 1;
-	f32 l0  = 2 * game.player.z + 1;
+	f32 u0  = 2 * camera.position.z - 1;
+	f32 l0  = 2 * camera.position.z + 1;
 	f32 zz0 = yc0 * cos_theta + xc0 * sin_theta;
 
 	// NOTE(bill): -1.0f is to center player
-	f32 xc1 = 2 * (p1.x - game.player.x) - 1.0f;
-	f32 yc1 = 2 * (p1.y - game.player.y) - 1.0f;
+	f32 xc1 = 2 * (p1.x - camera.position.x) - 1.0f;
+	f32 yc1 = 2 * (p1.y - camera.position.y) - 1.0f;
 
 	f32 xx1 = xc1 * cos_theta - yc1 * sin_theta;
-	f32 u1  = 2 * game.player.z - 1;
-	f32 l1  = 2 * game.player.z + 1;
+	f32 u1  = 2 * camera.position.z - 1;
+	f32 l1  = 2 * camera.position.z + 1;
 	f32 zz1 = yc1 * cos_theta + xc1 * sin_theta;
 
 	f32 xt0 = 0;
@@ -1125,10 +2048,14 @@ render_wall(Game& game, int tex, const Vector2& p0, const Vector2& p1)
 		xt1         = lerp(xt0, xt1, t);
 	}
 
-	f32 xpixel0 = (xx0 / zz0 / game.player.fov) + x_center;
-	f32 xpixel1 = (xx1 / zz1 / game.player.fov) + x_center;
+	f32 xpixel0 = (xx0 / zz0 * camera.inv_fov) + x_center;
+	f32 xpixel1 = (xx1 / zz1 * camera.inv_fov) + x_center;
 	if (xpixel0 >= xpixel1)
 		return;
+	// NOTE(bill): Wholly left of the screen, the clamp below would otherwise
+	// draw its extrapolated end into column 0
+	if (xpixel1 < 0)
+		return;
 
 	int xp0 = ceil(xpixel0);
 	int xp1 = ceil(xpixel1);
@@ -1137,11 +2064,11 @@ render_wall(Game& game, int tex, const Vector2& p0, const Vector2& p1)
 	if (xp1 >= width)
 		xp1 = width - 1;
 
-	f32 ypixel00 = (u0 / zz0 / game.player.fov) + y_center;
-	f32 ypixel01 = (l0 / zz0 / game.player.fov) + y_center;
+	f32 ypixel00 = (u0 / zz0 * camera.inv_fov) + y_center;
+	f32 ypixel01 = (l0 / zz0 * camera.inv_fov) + y_center;
 
-	f32 ypixel10 = (u1 / zz1 / game.player.fov) + y_center;
-	f32 ypixel11 = (l1 / zz1 / game.player.fov) + y_center;
+	f32 ypixel10 = (u1 / zz1 * camera.inv_fov) + y_center;
+	f32 ypixel11 = (l1 / zz1 * camera.inv_fov) + y_center;
 
 	f32 iz0 = 1.0f / (f32)zz0;
 	f32 iz1 = 1.0f / (f32)zz1;
@@ -1215,28 +2142,32 @@ apply_post_fx(Framebuffer& display, f32 fog_strength)
 }
 
 void
-render_sprite(Game& game, const Bitmap& spritesheet, int tex, const Vector3& position, const Vector2& scale)
+render_sprite(Game& game, const Camera& camera, const Bitmap& spritesheet, int tex, const Vector3& position, const Vector2& scale)
 {
-	const int width     = game.display.width;
-	const int height    = game.display.height;
-	const f32 x_center  = 0.5f * width;
-	const f32 y_center  = (0.5f + game.player.pitch) * height;
-	const f32 cos_theta = cosf(game.player.yaw);
-	const f32 sin_theta = sinf(game.player.yaw);
+	f32 xc = +2 * (camera.position.x - position.x);
+	f32 yc = -2 * (camera.position.y - position.y);
+	f32 yy = +2 * (camera.position.z - position.z);
 
-	////////////////
+	f32 xx = xc * camera.cos_yaw + yc * camera.sin_yaw;
+	f32 zz = yc * camera.cos_yaw - xc * camera.sin_yaw;
 
-	f32 xc = +2 * (game.player.x - position.x);
-	f32 yc = -2 * (game.player.y - position.y);
-	f32 yy = +2 * (game.player.z - position.z);
+	draw_sprite(game, camera, spritesheet, tex, xx, yy, zz, scale);
+}
 
-	f32 xx = xc * cos_theta + yc * sin_theta;
-	f32 zz = yc * cos_theta - xc * sin_theta;
+// NOTE(bill): `xx`, `yy` and `zz` are already in view space, see
+// `render_sprite` and `batch_view_transform`
+void
+draw_sprite(Game& game, const Camera& camera, const Bitmap& spritesheet, int tex, f32 xx, f32 yy, f32 zz, const Vector2& scale)
+{
+	const int width    = camera.width;
+	const int height   = camera.height;
+	const f32 x_center = camera.x_center;
+	const f32 y_center = camera.y_center;
 
 	if (zz < 0.001f)
 		return;
 
-	f32 fz = 1.0f / (game.player.fov * zz);
+	f32 fz = camera.inv_fov / zz;
 
 	f32 xpixel = x_center - xx * fz;
 	f32 ypixel = y_center + yy * fz;
@@ -3,8 +3,11 @@
 
 #include "common.hpp"
 #include "math.hpp"
+#include "math_batch.hpp"
+#include "timer_wheel.hpp"
 #include "bitmap.hpp"
 #include "level.hpp"
+#include "level_manager.hpp"
 
 constexpr int SCREEN_WIDTH   = 160;
 constexpr int SCREEN_HEIGHT  = 90;
@@ -21,7 +24,44 @@ constexpr int CHARS_LENGTH = 104;
 constexpr int CHAR_WIDTH   = 6;
 constexpr int CHAR_HEIGHT  = 8;
 
-constexpr int MAX_PARTICLES = 256;
+constexpr int MAX_PARTICLES = 256; // NOTE(bill): Must be a power of two, see `get_particle`
+constexpr int MAX_EVENTS    = 512;
+
+// NOTE(bill): A frame never runs more ticks than this, anything beyond that is
+// dropped rather than letting one slow frame snowball into more slow frames
+constexpr int MAX_TICKS_PER_FRAME = 8;
+
+// NOTE(bill): Cooldowns are the tick they end on, against `Game::tick`, so
+// nothing has to count them down. A zeroed one has always ended.
+inline u32
+start_cooldown(u32 tick, f32 seconds)
+{
+	return tick + (u32)(seconds / TIME_STEP + 0.5f);
+}
+
+inline b32
+is_cooling_down(u32 ends, u32 tick)
+{
+	return (s32)(ends - tick) > 0;
+}
+
+// NOTE(bill): Entity simulation level of detail, distances in tiles
+constexpr f32 LOD_NEAR_DISTANCE     = 8.0f;  // Full update every tick
+constexpr f32 LOD_MID_DISTANCE      = 16.0f; // Full update every `LOD_MID_INTERVAL` ticks, collisions every tick
+constexpr u32 LOD_MID_INTERVAL      = 4;     // NOTE(bill): Must be a power of two
+constexpr f32 LOD_CATCH_UP_DISTANCE = 4.0f;  // Furthest a far entity walks on coming closer, see `catch_up_entity_position`
+
+// NOTE(bill): Length of the `SDL_GetKeyboardState` array. Emscripten's keycodes
+// use (1 << 10) as the scancode mask so they all fit
+constexpr int MAX_KEYS = 0x10000;
+
+// NOTE(bill): `Random_Series` stream per subsystem, all seeded from the one
+// game seed by `seed_game_random`
+enum Random_Stream : u64 {
+	RANDOM_STREAM_GAMEPLAY  = 1,
+	RANDOM_STREAM_PARTICLES = 2,
+	RANDOM_STREAM_BOT       = 3, // NOTE(bill): Scripted input in the tools
+};
 
 inline int
 get_char_index(char c)
@@ -49,11 +89,46 @@ enum Spell_Type {
 	SPELL_AIR,
 };
 
+// NOTE(bill): Costs are per second of casting. Effects on a mob are scaled by
+// how squarely and how closely it is hit, see `update_spells`.
+struct Spell_Info {
+	int tex; // NOTE(bill): In `art::particles`
+
+	f32 health_cost;
+	f32 mana_cost;
+
+	f32 push;
+	f32 damage;
+	f32 earth_cooldown; // NOTE(bill): Slows the mob down
+	f32 water_cooldown; // Makes the mob wander
+};
+
+// NOTE(bill): Indexed by `Spell_Type`
+constexpr Spell_Info SPELL_INFO[] = {
+    // tex  health mana push damage earth water
+    {0x00, 0,     0,   0,   0,     0,    0},    // SPELL_NONE
+    {0x00, 1.5f,  5,   10,  10,    0,    0},    // SPELL_FIRE
+    {0x10, 0.5f,  8,   5,   5,     2,    0},    // SPELL_EARTH
+    {0x20, 0.5f,  7,   8,   7,     0,    3},    // SPELL_WATER
+    {0x30, 0.5f,  7,   20,  3,     0,    0},    // SPELL_AIR
+};
+
+inline const Spell_Info&
+get_spell_info(Spell_Type spell)
+{
+	if (spell < 0 || spell > SPELL_AIR) // NOTE(bill): Extra scrolls go past the last spell
+		return SPELL_INFO[SPELL_NONE];
+	return SPELL_INFO[spell];
+}
+
+// NOTE(bill): Plain data, copy it freely
 struct Player {
-	Vector3 position;
-	f32& x = position.x;
-	f32& y = position.y;
-	f32& z = position.z;
+	union {
+		Vector3 position;
+		struct {
+			f32 x, y, z;
+		};
+	};
 
 	f32 pitch, yaw;
 	f32 fov;
@@ -70,19 +145,155 @@ struct Player {
 	int spell_count;
 	Spell_Type curr_spell;
 	b32 spell_active;
-	f32 spell_cooldown;
-	f32 new_spell_cooldown;
+	u32 spell_cooldown_ends;
+	u32 new_spell_cooldown_ends;
 
 };
 
+// NOTE(bill): The player's view worked out once, per frame for rendering and
+// per tick for the update. Nothing downstream calls sinf/cosf on the yaw.
+struct Camera {
+	Vector3 position;
+	f32 pitch, yaw;
+	f32 cos_yaw, sin_yaw;
+
+	Vector2 forwards;
+	Vector2 sidewards;
+
+	f32 fov;     // NOTE(bill): World units per pixel at depth 1
+	f32 inv_fov; // Pixels per world unit at depth 1
+	int width, height;
+	f32 x_center, y_center;
+
+	// NOTE(bill): The view cone on the ground plane, its edges are
+	// `cone_slope` to the side per unit forwards. `cone_scale` turns a
+	// distance past an edge along the sidewards axis into a true distance.
+	f32 cone_slope;
+	f32 cone_scale;
+};
+
 struct Particle {
 	Vector3 position;
 	Vector3 velocity;
 	Vector2 scale;
 	int tex;
-	f32 life;
+	u32 expires; // NOTE(bill): Tick it is retired on, see `update_particles`
 };
 
+// NOTE(bill): A batch of smoke particles from one place, see `spawn_particles`
+struct Particle_Spawn {
+	Vector3 position;
+	Vector3 velocity; // NOTE(bill): Added to every particle
+	int tex;          // First of 8 variations, one is picked per batch
+	f32 speed;        // Scales the random smoke velocity, 0 is 1
+	f32 jitter;       // Random offset in each axis
+	f32 z_spread;     // Random extra upwards velocity
+};
+
+// NOTE(bill): Particles an entity gives off while the player is within
+// `EMITTER_RANGE`, see `update_emitters`. Positions are relative to the
+// entity, `lead` towards the player and `side` to the right as they see it.
+struct Emitter_Def {
+	f32 rate; // NOTE(bill): Particles per second, 0 is no emitter
+	int tex;  // In `art::particles`
+	f32 speed;
+	f32 lead;
+	f32 side;
+	f32 height;
+	f32 jitter;
+};
+
+constexpr f32 EMITTER_RANGE = 6.0f;
+// NOTE(bill): How far past the view cone an emitter's particles can drift
+// in their life, plus their size
+constexpr f32 EMITTER_CULL_MARGIN = 2.0f;
+
+// NOTE(bill): Indexed by `get_entity_id`
+constexpr Emitter_Def ENTITY_EMITTERS[ENTITY_ID_COUNT] = {
+    // rate tex   speed lead  side   height jitter
+    {0,     0x00, 0,    0,    0,     0,     0},     // ENTITY_NONE
+    {60,    0x40, 3,    0,    0,     0,     0.25f}, // ENTITY_PORTAL
+    {0,     0x00, 0,    0,    0,     0,     0},     // ENTITY_SCROLL
+    {0,     0x00, 0,    0,    0,     0,     0},     // ENTITY_HEALTH_POTION
+    {0,     0x00, 0,    0,    0,     0,     0},     // ENTITY_MANA_POTION
+    {0,     0x00, 0,    0,    0,     0,     0},     // ENTITY_PRISONER
+    {0,     0x00, 0,    0,    0,     0,     0},     // ENTITY_PRISON_GUARD
+    {7.5f,  0x10, 1,    0.1f, 0.3f,  0.2f,  0},     // ENTITY_MAGE
+    {7.5f,  0x50, 2,    0.1f, -0.3f, 0.2f,  0},     // ENTITY_BOSS
+};
+
+
+enum Sound_Id {
+	SOUND_POWER_UP,
+	SOUND_HIT0,
+	SOUND_HIT1,
+	SOUND_FIRE,
+
+	SOUND_COUNT,
+};
+
+enum Event_Type {
+	EVENT_SOUND,
+	EVENT_PARTICLE_BURST,
+	EVENT_PICKUP,
+	EVENT_DEATH,
+};
+
+// NOTE(bill): Side effects of a tick, queued by the update loops and handled
+// in batches by `process_events` once the simulation is done
+struct Game_Event {
+	Event_Type type;
+	union {
+		Sound_Id sound;
+
+		struct {
+			Particle_Spawn spawn;
+			int count;
+		} burst;
+
+		struct {
+			Entity_Type type;
+			Vector3 position;
+		} entity; // NOTE(bill): Pickups and deaths
+	};
+};
+
+// NOTE(bill): What a `Timer` in `Game::timers` does when it fires, see `process_timers`
+enum Timer_Type : u32 {
+	TIMER_SPELL_READY, // NOTE(bill): The player can cast again
+};
+
+// NOTE(bill): Accumulated milliseconds spent in each subsystem of `update_game`
+struct Tick_Timings {
+	f64 update_entities;
+	f64 update_particles;
+	f64 handle_collisions;
+	f64 remove_dead_entities;
+};
+
+struct Replay;
+struct Game;
+
+// NOTE(bill): The parts of `update_game` with a slow but plain reference
+// version kept to check faster ones against, see sim_check.cpp. A faster one
+// goes in `SIM_PROCS` only once it matches `SIM_PROCS_REFERENCE` tick for tick.
+struct Sim_Procs {
+	void (*update_particles)(Game& game, const Camera& camera, f32 dt);
+	void (*update_entities)(Game& game, Level& level, f32 dt);
+	void (*update_triggers)(Game& game, Level& level);
+	void (*handle_collisions)(Game& game, f32 dt);
+};
+
+// NOTE(bill): Same again for the render kernels, see render_check.cpp. A faster
+// one goes in `RENDER_PROCS` only once its pixels and depths match
+// `RENDER_PROCS_REFERENCE` over the whole pose set.
+struct Render_Procs {
+	void (*render_floors)(Game& game, const Camera& camera, b32 draw_ceiling);
+	void (*render_walls)(Game& game, const Camera& camera, Level& level);
+	void (*render_entities)(Game& game, const Camera& camera);
+	void (*render_particles)(Game& game, const Camera& camera);
+	void (*apply_post_fx)(Framebuffer& display, f32 fog_strength);
+};
 
 struct Game {
 	SDL_Surface* window;
@@ -90,12 +301,14 @@ struct Game {
 	Framebuffer display;
 	Player player;
 
-	Level level001;
+	Level level001;         // NOTE(bill): The tools' one level, the game itself uses `levels`
+	Level_Manager* levels;
 	Level* curr_level;
 
 	b32 running;
 	b32 has_focus;
 	b32 has_finished;
+	b32 headless; // NOTE(bill): No audio, video or logging
 
 	const u8* keys;
 
@@ -108,10 +321,86 @@ struct Game {
 	u32 frame_count;
 	u32 fps;
 
-	f32 killed_a_prisoner_cooldown;
+	u64 dropped_ticks;        // NOTE(bill): Total ticks lost to `MAX_TICKS_PER_FRAME`
+	u64 dropped_ticks_logged; // How many of those the log has reported
+	u32 capped_frames;        // Frames that hit the cap since the last report
+
+	u32 killed_a_prisoner_cooldown_ends;
+
+	// NOTE(bill): Simulation clock and randomness, never wall clock time
+	u32 tick;
+	f64 sim_time;
+	Random_Series rng;          // NOTE(bill): Gameplay rolls, see `Random_Stream`
+	Random_Series particle_rng; // Particle looks only, never read by gameplay
+	Timer_Wheel timers;         // NOTE(bill): Expiries that do something, see `Timer_Type`
 
+	// NOTE(bill): Ring buffer in spawn order, see `get_particle`
+	u32 particle_first; // Serial of the oldest particle, every spawn gets the next one
 	int particle_count;
 	Particle particles[MAX_PARTICLES];
+
+	int event_count;
+	Game_Event events[MAX_EVENTS];
+	u32 pending_sounds; // NOTE(bill): Bit per `Sound_Id`, played by `update_audio`
+
+	Tick_Timings* timings; // NOTE(bill): Only set when profiling (e.g. benchmark.cpp)
+	Replay* replay;        // NOTE(bill): Records every tick when set
+	const Sim_Procs* procs;           // NOTE(bill): Null is `SIM_PROCS`
+	const Render_Procs* render_procs; // Null is `RENDER_PROCS`
+};
+
+static_assert((MAX_PARTICLES & (MAX_PARTICLES - 1)) == 0, "MAX_PARTICLES must be a power of two");
+
+// NOTE(bill): The `index`th oldest live particle
+inline Particle&
+get_particle(Game& game, int index)
+{
+	return game.particles[(game.particle_first + index) & (MAX_PARTICLES - 1)];
+}
+
+inline const Particle&
+get_particle(const Game& game, int index)
+{
+	return game.particles[(game.particle_first + index) & (MAX_PARTICLES - 1)];
+}
+
+// NOTE(bill): Everything `update_game` reads and writes, apart from the
+// static level data (grid, size, spawn point)
+struct Sim_State {
+	u32 tick;
+	f64 sim_time;
+	Random_Series rng;
+	Random_Series particle_rng;
+
+	Player player;
+	b32 has_finished;
+	u32 killed_a_prisoner_cooldown_ends;
+	u32 portal_cooldown_ends;
+	Timer_Wheel timers;
+
+	int entity_count;
+	int entity_capacity;
+	Entity_Hot* entity_hot;
+	Entity_Cold* entity_cold;
+
+	u32 particle_first;
+	int particle_count;
+	Particle particles[MAX_PARTICLES]; // NOTE(bill): Oldest first, not wrapped
+};
+
+// NOTE(bill): What rendering needs to blend between two ticks. Entities are
+// matched by index and particles by ring slot; a slot whose contents moved
+// too far in one tick (swap removal, teleport) snaps instead of blending.
+struct Tick_History {
+	Player player;
+
+	int entity_count;
+	int entity_capacity;
+	Vector3* entity_positions;
+
+	u32 particle_first;
+	int particle_count;
+	Vector3 particle_positions[MAX_PARTICLES]; // NOTE(bill): By ring slot
 };
 
 namespace art
@@ -145,9 +434,54 @@ create_framebuffer(int width, int height);
 b32
 init(Game& game);
 
+void
+shutdown(Game& game);
+
+void
+reset_player(Game& game);
+
+void
+switch_level(Game& game, Level* level, Tick_History* history = nullptr);
+
+Camera
+make_camera(const Player& player, int width, int height);
+
+void
+seed_game_random(Game& game, u64 seed);
+
+void
+save_sim_state(const Game& game, Sim_State* state);
+
+void
+load_sim_state(Game& game, const Sim_State& state);
+
+void
+destroy_sim_state(Sim_State* state);
+
+void
+save_tick_history(const Game& game, Tick_History* history);
+
+void
+load_tick_history(Game& game, const Tick_History& history);
+
+void
+blend_tick_history(Game& game, const Tick_History& prev, f32 t);
+
+void
+destroy_tick_history(Tick_History* history);
+
 void
 add_particle(Game& game, const Particle& particle);
 
+void
+push_event(Game& game, const Game_Event& event);
+
+void
+process_events(Game& game);
+
+void
+update_audio(Game& game);
+
 void
 clear_buffers(Framebuffer& display, Color clear_color);
 
@@ -158,16 +492,22 @@ void
 handle_collisions(Game& game, f32 dt);
 
 void
-render_floors(Game& game, b32 draw_ceiling);
+handle_collisions_reference(Game& game, f32 dt);
+
+void
+render_floors(Game& game, const Camera& camera, b32 draw_ceiling);
 
 void
-render_wall(Game& game, int tex, const Vector2& p0, const Vector2& p1);
+render_wall(Game& game, const Camera& camera, int tex, const Vector2& p0, const Vector2& p1);
 
 void
 apply_post_fx(Framebuffer& display, f32 fog_strength);
 
 void
-render_sprite(Game& game, const Bitmap& spritesheet, int tex, const Vector3& position, const Vector2& scale = {1, 1});
+render_sprite(Game& game, const Camera& camera, const Bitmap& spritesheet, int tex, const Vector3& position, const Vector2& scale = {1, 1});
+
+void
+draw_sprite(Game& game, const Camera& camera, const Bitmap& spritesheet, int tex, f32 xx, f32 yy, f32 zz, const Vector2& scale = {1, 1});
 
 void
 render_text(Game& game, const char* str, const Vector2& position, Color color);
@@ -176,6 +516,6 @@ void
 render_ui(Game& game);
 
 void
-render_level(Game& game);
+render_level(Game& game, const Camera& camera, f32 fog_strength);
 
 #endif
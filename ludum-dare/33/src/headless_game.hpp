@@ -0,0 +1,52 @@
+#ifndef HEADLESS_GAME_HPP
+#define HEADLESS_GAME_HPP
+
+#include "game.hpp"
+
+// NOTE(bill): What the headless checks play with: a bot that presses keys
+// from its own random series, and a game on an instance of a loaded level
+// that lasts the whole session. Include after game.cpp.
+
+// NOTE(bill): Holds a random set of keys for a random number of ticks
+inline void
+script_keys(Random_Series& bot, u8* keys, u32* hold_ticks)
+{
+	if (*hold_ticks > 0) {
+		(*hold_ticks)--;
+		return;
+	}
+
+	*hold_ticks = 10 + random_u32(bot) % 110;
+	memset(keys, 0, MAX_KEYS);
+
+	keys[SDLK_UP]    = random_unit(bot) < 0.7f;
+	keys[SDLK_LEFT]  = random_unit(bot) < 0.2f;
+	keys[SDLK_RIGHT] = random_unit(bot) < 0.2f;
+	keys[SDLK_SPACE] = random_unit(bot) < 0.2f;
+	if (random_unit(bot) < 0.1f)
+		keys[SDLK_1 + random_u32(bot) % 4] = true;
+}
+
+// NOTE(bill): Throws away whatever `game` held. The player cannot die and has
+// every spell. Free with `destroy_level_instance(&game.level001)`.
+inline void
+start_headless_game(Game& game, const Level& level, const u8* keys, u32 seed,
+                    const Sim_Procs* procs = nullptr)
+{
+	destroy_level_instance(&game.level001);
+
+	game            = {};
+	game.level001   = instance_level(level);
+	game.curr_level = &game.level001;
+	game.keys       = keys;
+	game.headless   = true;
+	game.procs      = procs;
+	seed_game_random(game, seed);
+
+	reset_player(game);
+	game.player.max_health = game.player.health = 1e9f; // NOTE(bill): Play the whole session
+	game.player.spell_count = 4;
+	game.player.curr_spell  = SPELL_FIRE;
+}
+
+#endif
@@ -1,19 +1,66 @@
 #include "level.hpp"
 
-Level
-load_level_from_file(const char* filename)
+// NOTE(bill): Zeroed, from the level's arena when it has one
+internal void*
+level_alloc(Level& level, size_t size)
+{
+	if (level.arena)
+		return arena_alloc(*level.arena, size);
+	return calloc(1, size);
+}
+
+void
+create_level_grid(Level& level, int width, int height)
+{
+	level.width    = width;
+	level.height   = height;
+	level.blocks_x = (width + TILE_BLOCK_SIZE - 1) >> LOG2_TILE_BLOCK_SIZE;
+
+	const int blocks_y = (height + TILE_BLOCK_SIZE - 1) >> LOG2_TILE_BLOCK_SIZE;
+	level.grid = (Packed_Tile*)level_alloc(level, level.blocks_x * blocks_y * TILE_BLOCK_SIZE * TILE_BLOCK_SIZE * sizeof(Packed_Tile));
+}
+
+Packed_Tile
+pack_tile(Level& level, Tile tile)
+{
+	int type = 0;
+	while (type < 16 && TILE_TYPES[type] != tile.type)
+		type++;
+	if (type == 0 || type == 16)
+		return 0; // NOTE(bill): Not a type a level has
+
+	int look = 0;
+	while (look < level.look_count &&
+	       (level.looks[look].floor != tile.floor || level.looks[look].ceiling != tile.ceiling || level.looks[look].id != tile.id))
+		look++;
+	if (look == MAX_TILE_LOOKS) {
+		look = 0;
+		level.dropped_look_count++;
+	} else if (look == level.look_count) {
+		level.looks[look] = {tile.floor, tile.ceiling, TILE_NONE, tile.id};
+		level.look_count++;
+	}
+
+	return (Packed_Tile)((look << 4) | type);
+}
+
+internal Level
+load_level_from_image(const char* filename, Arena* arena)
 {
 	Level level = {};
 
 	Bitmap bitmap = load_bitmap_from_file(filename);
-	level.width   = bitmap.width;
-	level.height  = bitmap.height;
+	defer(destroy_bitmap(&bitmap));
+	if (bitmap.pixels == nullptr)
+		return level;
 
-	level.grid = (Tile*)calloc(level.width * level.height, sizeof(Tile));
+	level.arena = arena;
+	create_level_grid(level, bitmap.width, bitmap.height);
+	level.trigger_tiles = (int*)level_alloc(level, level.width * level.height * sizeof(int));
 
 	for (int y = 0; y < level.height; y++) {
 		for (int x = 0; x < level.width; x++) {
-			Tile& tile = level.grid[x + y * level.width];
+			Tile tile = {};
 
 			const Color color = get_bitmap_pixel(bitmap, x, y);
 
@@ -31,13 +78,13 @@ load_level_from_file(const char* filename)
 			if (color.b == 255 && color != WHITE) {
 				switch (color.r) {
 				case 0:
-					add_entity(level, create_mage({x, y, 0}));
+					add_entity(level, create_entity(ENTITY_MAGE, {x, y, 0}));
 					break;
 				case 32:
-					add_entity(level, create_prisoner({x, y, 0}));
+					add_entity(level, create_entity(ENTITY_PRISONER, {x, y, 0}));
 					break;
 				case 128:
-					add_entity(level, create_boss({x, y, 0}));
+					add_entity(level, create_entity(ENTITY_BOSS, {x, y, 0}));
 					break;
 				case 255: {
 					u16 portal_id = (color.g & 0xf0) / 16;
@@ -52,14 +99,14 @@ load_level_from_file(const char* filename)
 
 			if (color.r == 255 && color.b != 255) {
 				if (color.b == 0) {
-					add_entity(level, create_health_potion({x, y, 0}));
+					add_entity(level, create_entity(ENTITY_HEALTH_POTION, {x, y, 0}));
 				} else if (color.b == 1) {
-					add_entity(level, create_mana_potion({x, y, 0}));
+					add_entity(level, create_entity(ENTITY_MANA_POTION, {x, y, 0}));
 				}
 			}
 
 			if (color == GREEN) {
-				add_entity(level, create_scroll({x, y, 0}));
+				add_entity(level, create_entity(ENTITY_SCROLL, {x, y, 0}));
 			}
 
 			if (color == YELLOW) {
@@ -68,125 +115,745 @@ load_level_from_file(const char* filename)
 
 			tile.ceiling = 0x00;
 			tile.floor   = 0x10;
+
+			level.grid[get_tile_index(level, x, y)] = pack_tile(level, tile);
 		}
 	}
 
+	if (level.dropped_look_count > 0) {
+		printf("\"%s\" has more than %d tile looks, %d tiles use the first instead\n",
+		       filename, MAX_TILE_LOOKS, level.dropped_look_count);
+	}
+
 	return level;
 }
 
+// NOTE(bill): With an `arena` everything the level allocates, now and later,
+// comes from it. The level does not own the arena until it loads.
+Level
+load_level_from_file(const char* filename, Arena* arena)
+{
+	const size_t length = strlen(filename);
+	if (length > 6 && strcmp(filename + length - 6, ".level") == 0)
+		return load_compiled_level(filename, arena);
+	return load_level_from_image(filename, arena);
+}
+
+// NOTE(bill): Only for levels without an arena
+internal void
+free_trigger_chunks(Level& level)
+{
+	if (level.trigger_chunks) {
+		for (int i = 0; i < level.chunks_x * level.chunks_y; i++)
+			free(level.trigger_chunks[i]);
+		free(level.trigger_chunks);
+		level.trigger_chunks = nullptr;
+	}
+}
+
+void
+destroy_level(Level* level)
+{
+	if (level && level->pager) {
+		destroy_level_pager(level->pager); // NOTE(bill): Frees every chunk
+		level->chunks = nullptr;
+	}
+	if (level && level->file_view) {
+		munmap(level->file_view, level->file_view_size);
+		level->grid = nullptr; // NOTE(bill): It was in the file view
+	}
+	if (level && level->arena) {
+		destroy_arena(level->arena); // NOTE(bill): All of it in one go
+		*level = {};
+	}
+	if (level) {
+		free(level->grid);
+		free(level->entity_hot);
+		free(level->entity_cold);
+		free(level->sight_cache);
+		free(level->trigger_tiles);
+		free_trigger_chunks(*level);
+		*level = {};
+	}
+}
+
+// NOTE(bill): Shares the grid read-only and copies the entities, so many games
+// can play the same level at once
+Level
+instance_level(const Level& level)
+{
+	Level instance           = level;
+	instance.entity_count    = 0;
+	instance.entity_capacity = 0;
+	instance.entity_hot      = nullptr;
+	instance.entity_cold     = nullptr;
+	instance.sight_cache     = nullptr; // NOTE(bill): Not shared, instances run on other threads
+	instance.arena           = nullptr; // Its own memory is malloc'd
+	instance.trigger_tiles   = nullptr;
+	instance.file_view       = nullptr; // NOTE(bill): The grid still points into it
+	instance.pager           = nullptr; // Reads whatever chunks the level has resident
+	instance.trigger_chunks  = nullptr;
+
+	reserve_entities(instance, level.entity_count);
+	instance.entity_count = level.entity_count;
+	memcpy(instance.entity_hot, level.entity_hot, level.entity_count * sizeof(Entity_Hot));
+	memcpy(instance.entity_cold, level.entity_cold, level.entity_count * sizeof(Entity_Cold));
+
+	if (level.trigger_tiles) {
+		const int size         = level.width * level.height * sizeof(int);
+		instance.trigger_tiles = (int*)malloc(size);
+		memcpy(instance.trigger_tiles, level.trigger_tiles, size);
+	}
+
+	if (level.trigger_chunks) {
+		const int chunk_count   = level.chunks_x * level.chunks_y;
+		instance.trigger_chunks = (int**)calloc(chunk_count, sizeof(int*));
+		for (int i = 0; i < chunk_count; i++) {
+			if (level.trigger_chunks[i] == nullptr)
+				continue;
+			instance.trigger_chunks[i] = (int*)malloc(LEVEL_CHUNK_TILES * sizeof(int));
+			memcpy(instance.trigger_chunks[i], level.trigger_chunks[i], LEVEL_CHUNK_TILES * sizeof(int));
+		}
+	}
+
+	return instance;
+}
+
+// NOTE(bill): The grid belongs to the level it was instanced from
+void
+destroy_level_instance(Level* level)
+{
+	if (level) {
+		free(level->entity_hot);
+		free(level->entity_cold);
+		free(level->sight_cache);
+		free(level->trigger_tiles);
+		free_trigger_chunks(*level);
+		*level = {};
+	}
+}
+
+void
+reserve_entities(Level& level, int count)
+{
+	if (count <= level.entity_capacity)
+		return;
+
+	int capacity = 2 * level.entity_capacity;
+	if (capacity < MIN_ENTITY_CAPACITY)
+		capacity = MIN_ENTITY_CAPACITY;
+	if (capacity < count)
+		capacity = count;
+
+	Entity_Hot* hot   = nullptr;
+	Entity_Cold* cold = nullptr;
+	if (level.arena) {
+		// NOTE(bill): The old arrays stay in the arena until it goes
+		hot  = (Entity_Hot*)arena_alloc(*level.arena, capacity * sizeof(Entity_Hot));
+		cold = (Entity_Cold*)arena_alloc(*level.arena, capacity * sizeof(Entity_Cold));
+		if (hot == nullptr || cold == nullptr)
+			return;
+		memcpy(hot, level.entity_hot, level.entity_count * sizeof(Entity_Hot));
+		memcpy(cold, level.entity_cold, level.entity_count * sizeof(Entity_Cold));
+	} else {
+		hot  = (Entity_Hot*)realloc(level.entity_hot, capacity * sizeof(Entity_Hot));
+		cold = (Entity_Cold*)realloc(level.entity_cold, capacity * sizeof(Entity_Cold));
+	}
+	if (hot)
+		level.entity_hot = hot;
+	if (cold)
+		level.entity_cold = cold;
+	if (hot == nullptr || cold == nullptr)
+		return;
+
+	level.entity_capacity = capacity;
+}
+
+////////////////////////////////
+// Triggers
+////////////////////////////////
+
+// NOTE(bill): Where the tile's list starts. A chunked level makes the heads of
+// the tile's chunk the first time a trigger goes in it.
+internal int*
+get_trigger_head(Level& level, int x, int y)
+{
+	if (level.trigger_tiles)
+		return &level.trigger_tiles[x + y * level.width];
+
+	int*& heads = level.trigger_chunks[get_chunk_index(level, x, y)];
+	if (heads == nullptr)
+		heads = (int*)level_alloc(level, LEVEL_CHUNK_TILES * sizeof(int));
+	return heads ? &heads[get_chunk_offset(x, y)] : nullptr;
+}
+
+// NOTE(bill): Triggers never move, so they stay on the tile they were added on
+internal int*
+get_trigger_link(Level& level, int index)
+{
+	if (!has_trigger_index(level) || !get_archetype(level.entity_hot[index].type).trigger)
+		return nullptr;
+
+	const Vector3& p = level.entity_hot[index].position;
+	const int x      = (int)floorf(p.x + 0.5f);
+	const int y      = (int)floorf(p.y + 0.5f);
+	if (x < 0 || y < 0 || x >= level.width || y >= level.height)
+		return nullptr;
+
+	int* link = get_trigger_head(level, x, y);
+	if (link == nullptr)
+		return nullptr;
+	while (*link != 0 && *link != index + 1)
+		link = &level.entity_cold[*link - 1].next_trigger;
+	return link;
+}
+
+internal void
+link_trigger(Level& level, int index)
+{
+	level.entity_cold[index].next_trigger = 0;
+
+	int* link = get_trigger_link(level, index); // NOTE(bill): The end of its tile's list
+	if (link)
+		*link = index + 1;
+}
+
+void
+build_trigger_index(Level& level)
+{
+	if (level.grid) {
+		const int size = level.width * level.height * sizeof(int);
+		if (level.trigger_tiles == nullptr)
+			level.trigger_tiles = (int*)level_alloc(level, size);
+		memset(level.trigger_tiles, 0, size);
+	} else {
+		const int chunk_count = level.chunks_x * level.chunks_y;
+		if (level.trigger_chunks == nullptr)
+			level.trigger_chunks = (int**)level_alloc(level, chunk_count * sizeof(int*));
+		for (int i = 0; i < chunk_count; i++) {
+			if (level.trigger_chunks[i])
+				memset(level.trigger_chunks[i], 0, LEVEL_CHUNK_TILES * sizeof(int));
+		}
+	}
+
+	for (int i = 0; i < level.entity_count; i++)
+		link_trigger(level, i);
+}
+
+////////////////////////////////
+
 void
 add_entity(Level& level, const Entity& entity)
 {
-	if (level.entity_count == MAX_ENTITIES)
+	reserve_entities(level, level.entity_count + 1);
+	if (level.entity_count == level.entity_capacity)
 		return;
 
-	level.entities[level.entity_count++] = entity;
+	Entity_Hot& hot = level.entity_hot[level.entity_count];
+	hot             = {};
+	hot.position    = entity.position;
+	hot.type        = entity.type;
+	hot.alive       = entity.health > 0;
+
+	Entity_Cold& cold        = level.entity_cold[level.entity_count];
+	cold                     = {};
+	cold.data                = entity.data;
+	cold.velocity            = entity.velocity;
+	cold.health              = entity.health;
+	cold.max_health          = entity.max_health;
+	cold.mana                = entity.mana;
+	cold.max_mana            = entity.max_mana;
+	cold.earth_cooldown_ends = entity.earth_cooldown_ends;
+	cold.water_cooldown_ends = entity.water_cooldown_ends;
+	cold.updated_tick        = entity.updated_tick;
+
+	link_trigger(level, level.entity_count);
+	level.entity_count++;
 }
 
+// NOTE(bill): Gathers both halves back together, for anything that wants the
+// whole entity at once
 Entity
-create_prisoner(const Vector3& position)
+get_entity(const Level& level, int index)
 {
-	Entity e = {};
+	const Entity_Hot& hot   = level.entity_hot[index];
+	const Entity_Cold& cold = level.entity_cold[index];
+
+	Entity e              = {};
+	e.type                = hot.type;
+	e.data                = cold.data;
+	e.position            = hot.position;
+	e.velocity            = cold.velocity;
+	e.health              = cold.health;
+	e.max_health          = cold.max_health;
+	e.mana                = cold.mana;
+	e.max_mana            = cold.max_mana;
+	e.earth_cooldown_ends = cold.earth_cooldown_ends;
+	e.water_cooldown_ends = cold.water_cooldown_ends;
+	e.updated_tick        = cold.updated_tick;
+	return e;
+}
 
-	e.type = ENTITY_PRISONER;
+// NOTE(bill): Swaps the last entity into its place, so indices past `index`
+// are unchanged and the last one moves
+void
+remove_entity(Level& level, int index)
+{
+	const int last = level.entity_count - 1;
+
+	int* link = get_trigger_link(level, index);
+	if (link && *link == index + 1)
+		*link = level.entity_cold[index].next_trigger;
+	if (index != last) {
+		link = get_trigger_link(level, last);
+		if (link && *link == last + 1)
+			*link = index + 1;
+		level.entity_hot[index]  = level.entity_hot[last];
+		level.entity_cold[index] = level.entity_cold[last];
+	}
+	level.entity_count--;
+}
 
-	e.position = position;
+////////////////////////////////
+// Compiled Levels
+////////////////////////////////
 
-	e.max_health = e.health = 4;
-	e.max_mana = e.mana = 0;
+internal inline u64
+align_level_file_offset(u64 offset)
+{
+	return (offset + LEVEL_FILE_ALIGN - 1) & ~(u64)(LEVEL_FILE_ALIGN - 1);
+}
 
-	return e;
+internal inline int
+get_chunk_count(int tiles)
+{
+	return (tiles + LEVEL_CHUNK_SIZE - 1) >> LOG2_LEVEL_CHUNK_SIZE;
 }
 
-Entity
-create_scroll(const Vector3& position)
+internal u64
+get_level_file_grid_size(const Level_File_Header& header)
 {
-	Entity e = {};
+	if (header.chunk_log2 == 0) {
+		const u64 blocks_x = ((u64)header.width + TILE_BLOCK_SIZE - 1) >> LOG2_TILE_BLOCK_SIZE;
+		const u64 blocks_y = ((u64)header.height + TILE_BLOCK_SIZE - 1) >> LOG2_TILE_BLOCK_SIZE;
+		return blocks_x * blocks_y * TILE_BLOCK_SIZE * TILE_BLOCK_SIZE * sizeof(Packed_Tile);
+	}
+	return (u64)get_chunk_count(header.width) * (u64)get_chunk_count(header.height) * LEVEL_CHUNK_TILES * sizeof(Packed_Tile);
+}
 
-	e.type = ENTITY_SCROLL;
+// NOTE(bill): Everything the header says is in the file is, and in order.
+// The offsets come from the file, so nothing here adds to them before they
+// are known to be inside it.
+internal b32
+check_level_file_header(const Level_File_Header& header, u64 file_size)
+{
+	if (header.magic != LEVEL_FILE_MAGIC || header.version != LEVEL_FILE_VERSION ||
+	    header.header_size != sizeof(Level_File_Header) || header.tile_size != sizeof(Packed_Tile))
+		return false;
+	if (header.look_count > MAX_TILE_LOOKS)
+		return false;
+	if (header.chunk_log2 != 0 && header.chunk_log2 != LOG2_LEVEL_CHUNK_SIZE)
+		return false;
+	if (header.width <= 0 || header.height <= 0 ||
+	    header.width > LEVEL_FILE_MAX_SIDE || header.height > LEVEL_FILE_MAX_SIDE)
+		return false;
+	if (header.file_size != file_size)
+		return false;
+
+	// NOTE(bill): The tables are read by casting the mapped bytes
+	if (header.entity_offset % alignof(Level_File_Entity) != 0 ||
+	    header.portal_offset % alignof(Level_File_Portal) != 0 ||
+	    header.grid_offset % LEVEL_FILE_ALIGN != 0)
+		return false;
+
+	if (header.entity_offset < sizeof(Level_File_Header) ||
+	    header.portal_offset < header.entity_offset ||
+	    header.grid_offset < header.portal_offset ||
+	    header.grid_offset > file_size)
+		return false;
+
+	return header.entity_count <= (header.portal_offset - header.entity_offset) / sizeof(Level_File_Entity) &&
+	       header.portal_count <= (header.grid_offset - header.portal_offset) / sizeof(Level_File_Portal) &&
+	       get_level_file_grid_size(header) == file_size - header.grid_offset;
+}
 
-	e.position = position;
+// NOTE(bill): Every entity is a real type and there is one portal entry per
+// portal, in entity order. `tables` is as for `add_level_file_entities`.
+internal b32
+check_level_file_tables(const Level_File_Header& header, const u8* tables)
+{
+	const Level_File_Entity* entities = (const Level_File_Entity*)tables;
+	const Level_File_Portal* portals  = (const Level_File_Portal*)(tables + (header.portal_offset - header.entity_offset));
+
+	u32 entity_portals = 0;
+	for (u32 i = 0; i < header.entity_count; i++) {
+		const Entity_Type type = (Entity_Type)entities[i].type;
+		const int id           = get_entity_id(type);
+		if (type == ENTITY_NONE || id >= ENTITY_ID_COUNT || ENTITY_ARCHETYPES[id].type != type)
+			return false;
+		entity_portals += type == ENTITY_PORTAL;
+	}
+	if (entity_portals != header.portal_count)
+		return false;
+
+	for (u32 i = 0; i < header.portal_count; i++) {
+		const u32 index = portals[i].entity_index;
+		if (index >= header.entity_count || entities[index].type != ENTITY_PORTAL)
+			return false;
+		if (i > 0 && index <= portals[i - 1].entity_index)
+			return false;
+	}
 
-	e.max_health = e.health = 10000000;
-	e.max_mana = e.mana = 0;
+	return true;
+}
 
-	return e;
+// NOTE(bill): `tables` is the file from `entity_offset` up to the grid, and
+// has passed `check_level_file_tables`
+internal void
+add_level_file_entities(Level& level, const Level_File_Header& header, const u8* tables)
+{
+	const Level_File_Entity* entities = (const Level_File_Entity*)tables;
+	const Level_File_Portal* portals  = (const Level_File_Portal*)(tables + (header.portal_offset - header.entity_offset));
+
+	reserve_entities(level, header.entity_count);
+	u32 portal_index = 0;
+	for (u32 i = 0; i < header.entity_count; i++) {
+		const Level_File_Entity& fe = entities[i];
+		const Vector3 position      = {fe.x, fe.y, fe.z};
+
+		Entity e = create_entity((Entity_Type)fe.type, position);
+		if (portal_index < header.portal_count && portals[portal_index].entity_index == i) {
+			const Level_File_Portal& portal = portals[portal_index++];
+			e = create_portal(position, portal.portal_id, portal.connected_portal_id);
+		}
+		add_entity(level, e);
+	}
 }
 
+// NOTE(bill): A blocked grid is mapped and used in place, so only the pages
+// that are read cost anything. The mapping is private, `set_tile` writes go to
+// this process's copy of the page and never to the file. A chunked grid is
+// left to the pager and none of it is read here. Either way entities are
+// added as usual, a level has few of them.
+Level
+load_compiled_level(const char* filename, Arena* arena)
+{
+	Level level = {};
 
-Entity
-create_mage(const Vector3& position)
+	const int file = open(filename, O_RDONLY);
+	if (file < 0) {
+		printf("Could not load \"%s\" from file\n", filename);
+		return level;
+	}
+	b32 keep_file = false; // NOTE(bill): The pager reads from it
+	defer(if (!keep_file) close(file));
+
+	struct stat info;
+	Level_File_Header header = {};
+	if (fstat(file, &info) != 0 ||
+	    pread(file, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+	    !check_level_file_header(header, (u64)info.st_size)) {
+		printf("\"%s\" is not a version %u compiled level\n", filename, LEVEL_FILE_VERSION);
+		return level;
+	}
+
+	level.arena         = arena;
+	level.width         = header.width;
+	level.height        = header.height;
+	level.init_position = header.init_position;
+	level.look_count    = header.look_count;
+	memcpy(level.looks, header.looks, sizeof(level.looks));
+
+	if (header.chunk_log2 == 0) {
+		const size_t size = (size_t)info.st_size;
+		void* view        = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+		if (view == MAP_FAILED) {
+			printf("Could not map \"%s\"\n", filename);
+			return {};
+		}
+
+		const u8* bytes = (const u8*)view;
+		if (!check_level_file_tables(header, bytes + header.entity_offset)) {
+			printf("\"%s\" has a bad entity or portal table\n", filename);
+			munmap(view, size);
+			return {};
+		}
+
+		level.file_view      = view;
+		level.file_view_size = size;
+		level.blocks_x       = (level.width + TILE_BLOCK_SIZE - 1) >> LOG2_TILE_BLOCK_SIZE;
+		level.grid           = (Packed_Tile*)(bytes + header.grid_offset);
+		level.trigger_tiles  = (int*)level_alloc(level, level.width * level.height * sizeof(int));
+
+		add_level_file_entities(level, header, bytes + header.entity_offset);
+		return level;
+	}
+
+	const size_t tables_size = header.grid_offset - header.entity_offset;
+	u8* tables               = (u8*)malloc(tables_size);
+	defer(free(tables));
+	if (tables == nullptr || pread(file, tables, tables_size, header.entity_offset) != (ssize_t)tables_size) {
+		printf("Could not read \"%s\"\n", filename);
+		return {};
+	}
+	if (!check_level_file_tables(header, tables)) {
+		printf("\"%s\" has a bad entity or portal table\n", filename);
+		return {};
+	}
+
+	level.chunks_x = get_chunk_count(level.width);
+	level.chunks_y = get_chunk_count(level.height);
+	if (create_level_pager(level, file, header.grid_offset) == nullptr) {
+		printf("Could not page \"%s\"\n", filename);
+		return {};
+	}
+	keep_file = true;
+
+	level.trigger_chunks = (int**)level_alloc(level, level.chunks_x * level.chunks_y * sizeof(int*));
+	add_level_file_entities(level, header, tables);
+	return level;
+}
+
+// NOTE(bill): `level` itself must have a grid, i.e. come from an image
+b32
+save_compiled_level(const Level& level, const char* filename, b32 chunked)
 {
-	Entity e = {};
+	if (level.dropped_look_count > 0) {
+		printf("Could not save \"%s\", %d tiles have no look of their own\n", filename, level.dropped_look_count);
+		return false;
+	}
+	if (level.width > LEVEL_FILE_MAX_SIDE || level.height > LEVEL_FILE_MAX_SIDE) {
+		printf("Could not save \"%s\", levels are at most %d tiles a side\n", filename, LEVEL_FILE_MAX_SIDE);
+		return false;
+	}
 
-	e.type = ENTITY_MAGE;
+	Level_File_Header header = {};
+	header.magic             = LEVEL_FILE_MAGIC;
+	header.version           = LEVEL_FILE_VERSION;
+	header.header_size       = sizeof(Level_File_Header);
+	header.tile_size         = sizeof(Packed_Tile);
+	header.chunk_log2        = chunked ? LOG2_LEVEL_CHUNK_SIZE : 0;
+	header.look_count        = level.look_count;
+	header.width             = level.width;
+	header.height            = level.height;
+	header.init_position     = level.init_position;
+	header.entity_count      = level.entity_count;
+	memcpy(header.looks, level.looks, sizeof(header.looks));
+
+	for (int i = 0; i < level.entity_count; i++)
+		header.portal_count += level.entity_hot[i].type == ENTITY_PORTAL;
+
+	header.entity_offset = sizeof(Level_File_Header);
+	header.portal_offset = header.entity_offset + header.entity_count * sizeof(Level_File_Entity);
+	header.grid_offset   = align_level_file_offset(header.portal_offset + header.portal_count * sizeof(Level_File_Portal));
+	header.file_size     = header.grid_offset + get_level_file_grid_size(header);
+
+	FILE* file = fopen(filename, "wb");
+	if (file == nullptr) {
+		printf("Could not open \"%s\" for writing\n", filename);
+		return false;
+	}
+	defer(fclose(file));
 
-	e.position = position;
+	b32 ok = fwrite(&header, sizeof(header), 1, file) == 1;
 
-	e.max_health = e.health = 7;
-	e.max_mana = e.mana = 16;
+	for (int i = 0; ok && i < level.entity_count; i++) {
+		const Entity_Hot& hot = level.entity_hot[i];
 
-	return e;
+		Level_File_Entity fe = {};
+		fe.type              = hot.type;
+		fe.x                 = hot.position.x;
+		fe.y                 = hot.position.y;
+		fe.z                 = hot.position.z;
+		ok                   = fwrite(&fe, sizeof(fe), 1, file) == 1;
+	}
+
+	for (int i = 0; ok && i < level.entity_count; i++) {
+		if (level.entity_hot[i].type != ENTITY_PORTAL)
+			continue;
+
+		Level_File_Portal portal   = {};
+		portal.entity_index        = i;
+		portal.portal_id           = level.entity_cold[i].portal_id;
+		portal.connected_portal_id = level.entity_cold[i].connected_portal_id;
+		ok                         = fwrite(&portal, sizeof(portal), 1, file) == 1;
+	}
+
+	for (u64 offset = header.portal_offset + header.portal_count * sizeof(Level_File_Portal);
+	     ok && offset < header.grid_offset; offset++)
+		ok = fputc(0, file) != EOF;
+
+	const size_t grid_size = get_level_file_grid_size(header);
+	if (ok && !chunked)
+		ok = fwrite(level.grid, 1, grid_size, file) == grid_size;
+
+	// NOTE(bill): Tiles past the edge of the level pad the last chunks out
+	local_persist Packed_Tile chunk[LEVEL_CHUNK_TILES];
+	for (int cy = 0; ok && chunked && cy < get_chunk_count(level.height); cy++) {
+		for (int cx = 0; ok && cx < get_chunk_count(level.width); cx++) {
+			for (int y = 0; y < LEVEL_CHUNK_SIZE; y++) {
+				for (int x = 0; x < LEVEL_CHUNK_SIZE; x++)
+					chunk[get_chunk_offset(x, y)] = get_packed_tile(level, (cx << LOG2_LEVEL_CHUNK_SIZE) + x, (cy << LOG2_LEVEL_CHUNK_SIZE) + y);
+			}
+			ok = fwrite(chunk, sizeof(Packed_Tile), LEVEL_CHUNK_TILES, file) == LEVEL_CHUNK_TILES;
+		}
+	}
+
+	if (!ok)
+		printf("Could not write \"%s\"\n", filename);
+	return ok;
 }
 
-Entity
-create_portal(const Vector3& position, u16 portal_id, u16 connected_portal_id)
+////////////////////////////////
+// Line of Sight
+////////////////////////////////
+
+// NOTE(bill): Walks every tile the line between the two tile centres touches
+// (integer grid DDA). Where the line passes exactly through a corner it can
+// squeeze between the two tiles beside it unless both block.
+internal b32
+trace_line_of_sight(const Level& level, int x0, int y0, int x1, int y1)
 {
-	Entity e = {};
+	int dx = abs(x1 - x0);
+	int dy = abs(y1 - y0);
+	const int sx = x0 < x1 ? 1 : -1;
+	const int sy = y0 < y1 ? 1 : -1;
+
+	int x     = x0;
+	int y     = y0;
+	int steps = dx + dy;
+	int error = dx - dy;
+	dx *= 2;
+	dy *= 2;
+
+	while (steps > 0) {
+		if (error > 0) {
+			x += sx;
+			error -= dy;
+			steps--;
+		} else if (error < 0) {
+			y += sy;
+			error += dx;
+			steps--;
+		} else {
+			if (!is_see_through(level, x + sx, y) && !is_see_through(level, x, y + sy))
+				return false;
+			x += sx;
+			y += sy;
+			error += dx - dy;
+			steps -= 2;
+		}
 
-	e.type = ENTITY_PORTAL;
-	e.portal_id = portal_id;
-	e.connected_portal_id = connected_portal_id;
+		if (x == x1 && y == y1)
+			break; // NOTE(bill): The end tiles themselves never block
+		if (!is_see_through(level, x, y))
+			return false;
+	}
 
-	e.position = position;
+	return true;
+}
 
-	e.max_health = e.health = 20;
-	e.max_mana = e.mana = 0;
+internal inline int
+get_sight_tile(f32 p)
+{
+	return (int)floorf(p + 0.5f);
+}
 
-	return e;
+internal b32
+query_line_of_sight(Level& level, Sight_Cache& cache, const Sight_Query& query)
+{
+	const int x0 = get_sight_tile(query.from.x);
+	const int y0 = get_sight_tile(query.from.y);
+	const int x1 = get_sight_tile(query.to.x);
+	const int y1 = get_sight_tile(query.to.y);
+
+	if (x0 == x1 && y0 == y1)
+		return true;
+	if (x0 < 0 || y0 < 0 || x0 >= level.width || y0 >= level.height ||
+	    x1 < 0 || y1 < 0 || x1 >= level.width || y1 >= level.height)
+		return trace_line_of_sight(level, x0, y0, x1, y1); // NOTE(bill): Not cached
+
+	// NOTE(bill): Lower tile index first, sight is the same both ways
+	u64 a = (u64)(x0 + y0 * level.width);
+	u64 b = (u64)(x1 + y1 * level.width);
+	if (a > b) {
+		const u64 t = a;
+		a = b;
+		b = t;
+	}
+	const u64 pair = (a << 31) | b; // NOTE(bill): Never 0 as a < b
+	const u32 slot = (u32)((pair * 0x9e3779b97f4a7c15ull) >> 52) & (SIGHT_CACHE_SIZE - 1);
+
+	const u64 entry = cache.entries[slot];
+	if ((entry >> 1) == pair) {
+		cache.hits++;
+		return (b32)(entry & 1);
+	}
+
+	cache.misses++;
+	const b32 visible    = trace_line_of_sight(level, x0, y0, x1, y1);
+	cache.entries[slot] = (pair << 1) | (visible ? 1 : 0);
+	return visible;
 }
 
-Entity
-create_boss(const Vector3& position)
+internal Sight_Cache&
+get_sight_cache(Level& level)
 {
-	Entity e = {};
+	if (level.sight_cache == nullptr) {
+		level.sight_cache               = (Sight_Cache*)level_alloc(level, sizeof(Sight_Cache));
+		level.sight_cache->tile_version = level.tile_version;
+	}
 
-	e.type = ENTITY_BOSS;
+	Sight_Cache& cache = *level.sight_cache;
+	if (cache.tile_version != level.tile_version) {
+		memset(cache.entries, 0, sizeof(cache.entries));
+		cache.tile_version = level.tile_version;
+	}
 
-	e.position = position;
+	return cache;
+}
 
-	e.max_health = e.health = 60;
-	e.max_mana = e.mana = 70;
+b32
+has_line_of_sight(Level& level, const Vector2& from, const Vector2& to)
+{
+	return query_line_of_sight(level, get_sight_cache(level), {from, to});
+}
 
-	return e;
+// NOTE(bill): `visible[i]` is the answer to `queries[i]`
+void
+test_line_of_sight(Level& level, const Sight_Query* queries, int count, b32* visible)
+{
+	Sight_Cache& cache = get_sight_cache(level);
+	for (int i = 0; i < count; i++)
+		visible[i] = query_line_of_sight(level, cache, queries[i]);
 }
 
+////////////////////////////////
+
 Entity
-create_health_potion(const Vector3& position)
+create_entity(Entity_Type type, const Vector3& position)
 {
+	const Entity_Archetype& archetype = get_archetype(type);
+
 	Entity e = {};
 
-	e.type = ENTITY_HEALTH_POTION;
+	e.type = type;
 
 	e.position = position;
 
-	e.max_health = e.health = 10000000;
-	e.max_mana = e.mana = 0;
+	e.max_health = e.health = archetype.health;
+	e.max_mana = e.mana = archetype.mana;
 
 	return e;
 }
 
 Entity
-create_mana_potion(const Vector3& position)
+create_portal(const Vector3& position, u16 portal_id, u16 connected_portal_id)
 {
-	Entity e = {};
+	Entity e = create_entity(ENTITY_PORTAL, position);
 
-	e.type = ENTITY_MANA_POTION;
-
-	e.position = position;
-
-	e.max_health = e.health = 10000000;
-	e.max_mana = e.mana = 0;
+	e.portal_id = portal_id;
+	e.connected_portal_id = connected_portal_id;
 
 	return e;
 }
@@ -2,10 +2,12 @@
 #define LEVEL_HPP
 
 #include "math.hpp"
+#include "arena.hpp"
 
-constexpr int MAX_ENTITIES = 64;
+constexpr int MIN_ENTITY_CAPACITY = 64;
 
 enum Tile_Type : u8 {
+	TILE_NONE       = 0, // NOTE(bill): Outside the level
 	TILE_FLOOR      = 1,
 	TILE_WALL       = 2,
 	TILE_FALSE_WALL = 4 | TILE_FLOOR,
@@ -20,23 +22,54 @@ struct Tile {
 	u8 id; // NOTE(bill): Used to get info for other types
 };
 
+// NOTE(bill): How levels store tiles, a byte each. The low nibble is the type
+// (an index into `TILE_TYPES`), the high nibble its floor, ceiling and id (an
+// index into `Level::looks`). 0 is outside the level.
+typedef u8 Packed_Tile;
+
+constexpr int MAX_TILE_LOOKS = 16;
+
+constexpr Tile_Type TILE_TYPES[16] = {
+    TILE_NONE, TILE_FLOOR, TILE_WALL, TILE_FALSE_WALL, TILE_BOOKCASE, TILE_BARS,
+};
+
+// NOTE(bill): Grids are stored in 8x8 blocks, a block to 64 bytes, so the tiles
+// around one are a line or two away rather than a row or two
+constexpr int LOG2_TILE_BLOCK_SIZE = 3;
+constexpr int TILE_BLOCK_SIZE      = 1 << LOG2_TILE_BLOCK_SIZE;
+
+// NOTE(bill): Chunked levels keep their tiles in square chunks, see `Level::chunks`
+constexpr int LOG2_LEVEL_CHUNK_SIZE = 6;
+constexpr int LEVEL_CHUNK_SIZE      = 1 << LOG2_LEVEL_CHUNK_SIZE;
+constexpr int LEVEL_CHUNK_TILES     = LEVEL_CHUNK_SIZE * LEVEL_CHUNK_SIZE;
+
 #define BIT(x) (1 << (x))
 
-enum Entity_Type {
+// NOTE(bill): The low byte is a dense id (see `get_entity_id`), the bits
+// above it say what kind of entity it is
+enum Entity_Type : u16 {
 	ENTITY_NONE          = 0,
-	ENTITY_THING         = BIT(0),
-	ENTITY_MOB           = BIT(1),
-	ENTITY_PORTAL        = BIT(2) | ENTITY_THING, // Teleporting
-	ENTITY_SCROLL        = BIT(3) | ENTITY_THING, // Gain Spell
-	ENTITY_HEALTH_POTION = BIT(4) | ENTITY_THING, // Increase Health
-	ENTITY_MANA_POTION   = BIT(5) | ENTITY_THING, // Increase Mana
-
-	ENTITY_PRISONER     = BIT(6) | ENTITY_MOB, // Random
-	ENTITY_PRISON_GUARD = BIT(7) | ENTITY_MOB, // Move back and forth
-	ENTITY_MAGE         = BIT(8) | ENTITY_MOB, // Magic, AI, Random
-	ENTITY_BOSS         = BIT(9) | ENTITY_MOB, // Magic, AI, Random, Fast
+	ENTITY_THING         = BIT(8),
+	ENTITY_MOB           = BIT(9),
+	ENTITY_PORTAL        = 1 | ENTITY_THING, // Teleporting
+	ENTITY_SCROLL        = 2 | ENTITY_THING, // Gain Spell
+	ENTITY_HEALTH_POTION = 3 | ENTITY_THING, // Increase Health
+	ENTITY_MANA_POTION   = 4 | ENTITY_THING, // Increase Mana
+
+	ENTITY_PRISONER     = 5 | ENTITY_MOB, // Random
+	ENTITY_PRISON_GUARD = 6 | ENTITY_MOB, // Move back and forth
+	ENTITY_MAGE         = 7 | ENTITY_MOB, // Magic, AI, Random
+	ENTITY_BOSS         = 8 | ENTITY_MOB, // Magic, AI, Random, Fast
 };
 
+constexpr int ENTITY_ID_COUNT = 9;
+
+constexpr int
+get_entity_id(Entity_Type type)
+{
+	return type & 0xff;
+}
+
 #undef BIT
 
 struct Entity {
@@ -59,60 +92,432 @@ struct Entity {
 	f32 mana;
 	f32 max_mana;
 
-	f32 earth_cooldown;
-	f32 water_cooldown;
+	u32 earth_cooldown_ends; // NOTE(bill): Ticks, see `is_cooling_down`
+	u32 water_cooldown_ends;
+
+	u32 updated_tick; // NOTE(bill): Last tick the mana regen was brought up to, see `catch_up_entity`
+};
+
+// NOTE(bill): Levels do not store `Entity` as is. What every distance check,
+// radius filter and render loop reads lives in `Entity_Hot`, four to a cache
+// line, and the rest lives in `Entity_Cold` at the same index.
+struct Entity_Hot {
+	Vector3 position;
+	Entity_Type type;
+	b8 alive; // NOTE(bill): Cleared once health runs out, see `remove_dead_entities`
+	u8 padding;
+};
+
+static_assert(sizeof(Entity_Hot) == 16, "Entity_Hot must stay 16 bytes");
+
+struct Entity_Cold {
+	union {
+		u32 data;
+		u32 state;
+		struct {
+			u16 portal_id;
+			u16 connected_portal_id;
+		};
+	};
+
+	Vector2 velocity;
+
+	f32 health;
+	f32 max_health;
+
+	f32 mana;
+	f32 max_mana;
+
+	u32 earth_cooldown_ends;
+	u32 water_cooldown_ends;
+
+	u32 updated_tick;
+
+	f32 emitted; // NOTE(bill): Particles its emitter owes, see `update_emitters`
+
+	int next_trigger; // NOTE(bill): Index + 1 of the next trigger on the same tile, see `Level::trigger_tiles`
+};
+
+// NOTE(bill): Everything fixed about a type of entity, see `ENTITY_ARCHETYPES`
+struct Entity_Archetype {
+	Entity_Type type;
+	int tex; // NOTE(bill): In `art::sprites`
+
+	f32 health; // NOTE(bill): Starting and max
+	f32 mana;
+
+	b8 pickup;  // NOTE(bill): Taken when the player walks over it
+	b8 trigger; // Stands still and does something when the player walks over it
+	b8 bobs;    // Rendering only
+
+	// NOTE(bill): Movement, tiles per second
+	f32 speed;        // Towards the player
+	f32 flee_speed;   // Away from the player when within a tile
+	f32 wander_speed; // Random walk
+
+	// NOTE(bill): Casting at the player, 0 `attack_range` never attacks
+	f32 attack_range;
+	f32 attack_chance;     // Per tick
+	f32 attack_damage_min; // Per second
+	f32 attack_damage_max;
+	f32 attack_mana;       // Per second, 0 is free
+	f32 mana_regen;        // Per second
+	int attack_tex;        // In `art::particles`
+	int attack_particles;
+};
+
+// NOTE(bill): Indexed by `get_entity_id`
+constexpr Entity_Archetype ENTITY_ARCHETYPES[ENTITY_ID_COUNT] = {
+    // type                tex   health    mana pickup trigger bobs   speed flee wander range chance min max mana regen tex   count
+    {ENTITY_NONE,          0x00, 0,        0,   false, false,  false, 0,    0,   0,     0,    0,     0,  0,  0,   0,    0x00, 0},
+    {ENTITY_PORTAL,        0x00, 20,       0,   false, true,   false, 0,    0,   0,     0,    0,     0,  0,  0,   0,    0x00, 0},
+    {ENTITY_SCROLL,        0x30, 10000000, 0,   true,  true,   true,  0,    0,   0,     0,    0,     0,  0,  0,   0,    0x00, 0},
+    {ENTITY_HEALTH_POTION, 0x31, 10000000, 0,   true,  true,   true,  0,    0,   0,     0,    0,     0,  0,  0,   0,    0x00, 0},
+    {ENTITY_MANA_POTION,   0x32, 10000000, 0,   true,  true,   true,  0,    0,   0,     0,    0,     0,  0,  0,   0,    0x00, 0},
+    {ENTITY_PRISONER,      0x20, 4,        0,   false, false,  false, 0,    0,   0,     0,    0,     0,  0,  0,   0,    0x00, 0},
+    {ENTITY_PRISON_GUARD,  0x00, 4,        0,   false, false,  false, 0,    0,   0,     0,    0,     0,  0,  0,   0,    0x00, 0}, // NOTE(bill): No sprite yet
+    {ENTITY_MAGE,          0x10, 7,        16,  false, false,  false, 2,    0,   3,     10,   0.1f,  3,  6,  0,   0,    0x10, 3},
+    {ENTITY_BOSS,          0x40, 60,       70,  false, false,  false, 0.5f, 2,   2,     10,   0.1f,  10, 15, 1,   2,    0x50, 10},
+};
+
+constexpr b32
+archetypes_are_dense(int id = 0)
+{
+	return id == ENTITY_ID_COUNT ||
+	       (get_entity_id(ENTITY_ARCHETYPES[id].type) == id && archetypes_are_dense(id + 1));
+}
+
+static_assert(archetypes_are_dense(), "ENTITY_ARCHETYPES must be in `get_entity_id` order");
+
+inline const Entity_Archetype&
+get_archetype(Entity_Type type)
+{
+	return ENTITY_ARCHETYPES[get_entity_id(type)];
+}
+
+// NOTE(bill): Direct mapped, one entry per tile pair. Must be a power of two.
+constexpr int SIGHT_CACHE_SIZE = 1 << 12;
+
+// NOTE(bill): Line of sight results between tile pairs, see `test_line_of_sight`.
+// An entry is `(pair << 1) | visible`, 0 is empty. The whole cache is
+// dropped whenever the level's `tile_version` moves on.
+struct Sight_Cache {
+	u32 tile_version;
+	u64 hits;
+	u64 misses;
+	u64 entries[SIGHT_CACHE_SIZE];
 };
 
+struct Sight_Query {
+	Vector2 from;
+	Vector2 to;
+};
+
+struct Level_Pager;
+
 struct Level {
+	Arena* arena; // NOTE(bill): When set, all of the level's memory, see `load_level_from_file`
+
+	void* file_view; // NOTE(bill): When set, the mapped compiled level `grid` points into, see `load_compiled_level`
+	size_t file_view_size;
+
 	int width;
 	int height;
-	Tile* grid;
+	int blocks_x;     // NOTE(bill): Blocks per row of `grid`, see `get_tile_index`
+	Packed_Tile* grid;
+	u32 tile_version; // NOTE(bill): Bumped by `set_tile` and whenever chunks come and go
+
+	// NOTE(bill): Chunked levels only, where `grid` is null. The tiles are in
+	// `LEVEL_CHUNK_SIZE` square chunks the pager brings in and out around the
+	// player, see `update_level_pager`.
+	int chunks_x;
+	int chunks_y;
+	std::atomic<Packed_Tile*>* chunks; // NOTE(bill): Per chunk, null when not resident, owned by `pager`
+	Level_Pager* pager;                // Only on the level that loaded it, never on instances
+
+	int look_count;
+	Tile looks[MAX_TILE_LOOKS]; // NOTE(bill): What `Packed_Tile` indexes, `type` unused
+	int dropped_look_count;     // NOTE(bill): Tiles given the first look as theirs did not fit
+
+	Sight_Cache* sight_cache; // NOTE(bill): Per instance, made on first use
+
+	// NOTE(bill): Index + 1 of the first trigger entity on each tile, 0 is
+	// none, the rest follow `Entity_Cold::next_trigger`. Kept up to date by
+	// `add_entity` and `remove_entity` once built, see `build_trigger_index`.
+	int* trigger_tiles;
+	int** trigger_chunks; // NOTE(bill): The same for chunked levels, one chunk's worth made where a trigger first goes
 
 	Vector2 init_position;
 
-	f32 portal_cooldown;
+	u32 portal_cooldown_ends;
 
 	int entity_count;
-	Entity entities[MAX_ENTITIES];
+	int entity_capacity;
+	Entity_Hot* entity_hot;   // NOTE(bill): Grows as needed, see `add_entity`
+	Entity_Cold* entity_cold; // Same index as `entity_hot`
+};
+
+////////////////////////////////
+// Compiled Levels
+////////////////////////////////
+
+// NOTE(bill): What level_compiler.cpp writes and `load_compiled_level` maps.
+// Little endian, laid out as below:
+//
+//     Level_File_Header
+//     Level_File_Entity[entity_count]
+//     Level_File_Portal[portal_count]
+//     (zeroes up to `grid_offset`, a multiple of `LEVEL_FILE_ALIGN`)
+//     Packed_Tile[blocks_x * blocks_y][64], the grid as `Level::grid` has it
+//     and used in place, or when `chunk_log2` is set
+//     Packed_Tile[chunks_x * chunks_y][LEVEL_CHUNK_TILES], each chunk laid
+//     out by `get_chunk_offset` and the chunks row major, read in by the pager
+//
+// Bump `LEVEL_FILE_VERSION` whenever any of these, `Tile` or `Packed_Tile` change.
+constexpr u32 LEVEL_FILE_MAGIC    = 0x4c33444c; // NOTE(bill): "LD3L"
+constexpr u32 LEVEL_FILE_VERSION  = 3;
+constexpr u32 LEVEL_FILE_ALIGN    = 4096;       // NOTE(bill): A page, so the grid can be mapped as is
+constexpr s32 LEVEL_FILE_MAX_SIDE = 1 << 14;    // NOTE(bill): Keeps `width * height * sizeof(int)` in an int
+
+struct Level_File_Header {
+	u32 magic;
+	u32 version;
+	u32 header_size; // NOTE(bill): Layout checks, must match this build's
+	u32 tile_size;
+	u32 chunk_log2;  // NOTE(bill): 0 is a blocked grid, otherwise `LOG2_LEVEL_CHUNK_SIZE`
+	u32 look_count;
+
+	s32 width;
+	s32 height;
+	Vector2 init_position; // NOTE(bill): The spawn point
+
+	u32 entity_count;
+	u32 portal_count;
+
+	u64 entity_offset; // NOTE(bill): Byte offsets from the start of the file
+	u64 portal_offset;
+	u64 grid_offset;
+	u64 file_size;
+
+	Tile looks[MAX_TILE_LOOKS]; // NOTE(bill): As `Level::looks`
 };
 
+// NOTE(bill): Where every entity starts, the rest comes from its archetype
+struct Level_File_Entity {
+	u16 type; // NOTE(bill): `Entity_Type`
+	u16 padding;
+	f32 x, y, z;
+};
+
+// NOTE(bill): Sorted by `entity_index`, one per `ENTITY_PORTAL` in the entity table
+struct Level_File_Portal {
+	u32 entity_index;
+	u16 portal_id;
+	u16 connected_portal_id;
+};
+
+static_assert(sizeof(Tile) == 4, "Tile layout changed, bump LEVEL_FILE_VERSION");
+static_assert(sizeof(Packed_Tile) == 1, "Packed_Tile layout changed, bump LEVEL_FILE_VERSION");
+static_assert(sizeof(Level_File_Header) == 144, "Level_File_Header layout changed, bump LEVEL_FILE_VERSION");
+static_assert(sizeof(Level_File_Entity) == 16, "Level_File_Entity layout changed, bump LEVEL_FILE_VERSION");
+static_assert(sizeof(Level_File_Portal) == 8, "Level_File_Portal layout changed, bump LEVEL_FILE_VERSION");
+
+////////////////////////////////
+
+// NOTE(bill): Blocks row major, the tiles in a block row major
+inline int
+get_tile_index(const Level& l, int x, int y)
+{
+	const int block = (x >> LOG2_TILE_BLOCK_SIZE) + (y >> LOG2_TILE_BLOCK_SIZE) * l.blocks_x;
+	return (block << (2 * LOG2_TILE_BLOCK_SIZE)) |
+	       ((y & (TILE_BLOCK_SIZE - 1)) << LOG2_TILE_BLOCK_SIZE) | (x & (TILE_BLOCK_SIZE - 1));
+}
+
+// NOTE(bill): The chunk a tile is in and where it is in that chunk, which is
+// blocked the same way as a grid
+inline int
+get_chunk_index(const Level& l, int x, int y)
+{
+	return (x >> LOG2_LEVEL_CHUNK_SIZE) + (y >> LOG2_LEVEL_CHUNK_SIZE) * l.chunks_x;
+}
+
+inline int
+get_chunk_offset(int x, int y)
+{
+	constexpr int BLOCKS = LEVEL_CHUNK_SIZE / TILE_BLOCK_SIZE;
+	const int block = ((x & (LEVEL_CHUNK_SIZE - 1)) >> LOG2_TILE_BLOCK_SIZE) +
+	                  ((y & (LEVEL_CHUNK_SIZE - 1)) >> LOG2_TILE_BLOCK_SIZE) * BLOCKS;
+	return (block << (2 * LOG2_TILE_BLOCK_SIZE)) |
+	       ((y & (TILE_BLOCK_SIZE - 1)) << LOG2_TILE_BLOCK_SIZE) | (x & (TILE_BLOCK_SIZE - 1));
+}
+
+// NOTE(bill): False if it failed to load
+inline b32
+has_tiles(const Level& l)
+{
+	return l.grid != nullptr || l.chunks != nullptr;
+}
+
+// NOTE(bill): A tile in a chunk that is not resident reads as outside the level
+inline Packed_Tile
+get_packed_tile(const Level& l, int x, int y)
+{
+	if (x < 0 || y < 0 || x >= l.width || y >= l.height)
+		return 0;
+
+	if (l.grid)
+		return l.grid[get_tile_index(l, x, y)];
+
+	const Packed_Tile* chunk = l.chunks[get_chunk_index(l, x, y)].load(std::memory_order_acquire);
+	if (chunk == nullptr)
+		return 0;
+	return chunk[get_chunk_offset(x, y)];
+}
+
 inline Tile
 get_tile(const Level& l, int x, int y)
 {
-	if (x < 0 || y < 0 || x >= l.width || y >= l.height)
+	const Packed_Tile packed = get_packed_tile(l, x, y);
+	if (packed == 0)
 		return {};
 
-	return l.grid[x + y * l.width];
+	Tile tile = l.looks[packed >> 4];
+	tile.type = TILE_TYPES[packed & 0xf];
+	return tile;
 }
 
+// NOTE(bill): When only the type is wanted, it skips the look
+inline Tile_Type
+get_tile_type(const Level& l, int x, int y)
+{
+	return TILE_TYPES[get_packed_tile(l, x, y) & 0xf];
+}
+
+// NOTE(bill): Adds the tile's look to the level's if it is new. Past
+// `MAX_TILE_LOOKS` looks the tile gets the first one and is counted in
+// `dropped_look_count`.
+Packed_Tile
+pack_tile(Level& level, Tile tile);
+
+// NOTE(bill): Pages the chunk in first if it has to, see level_manager.cpp
+void
+set_chunked_tile(Level& level, Packed_Tile packed, int x, int y);
+
 inline void
 set_tile(Level& l, Tile tile, int x, int y)
 {
 	if (x < 0 || y < 0 || x >= l.width || y >= l.height)
 		return;
 
-	l.grid[x + y * l.width] = tile;
+	const Packed_Tile packed = pack_tile(l, tile);
+	assert(l.dropped_look_count == 0 && "More tile looks than a level can have");
+	if (l.grid == nullptr) {
+		set_chunked_tile(l, packed, x, y);
+		return;
+	}
+
+	l.grid[get_tile_index(l, x, y)] = packed;
+	l.tile_version++;
 }
 
+// NOTE(bill): Floors and bars can be seen through, everything else (walls,
+// bookcases, false walls and outside the level) blocks sight
+inline b32
+is_see_through(const Level& l, int x, int y)
+{
+	const Tile_Type type = get_tile_type(l, x, y);
+	return type == TILE_FLOOR || type == TILE_BARS;
+}
+
+// NOTE(bill): Every tile outside the level until set, from the level's arena
+// when it has one
+void
+create_level_grid(Level& level, int width, int height);
+
+// NOTE(bill): A compiled level if `filename` ends in ".level", otherwise an image
 Level
-load_level_from_file(const char* filename);
+load_level_from_file(const char* filename, Arena* arena = nullptr);
+
+// NOTE(bill): A chunked level keeps the file open for its pager
+Level
+load_compiled_level(const char* filename, Arena* arena = nullptr);
+
+b32
+save_compiled_level(const Level& level, const char* filename, b32 chunked = false);
+
+// NOTE(bill): See level_manager.cpp
+Level_Pager*
+create_level_pager(Level& level, int file, u64 grid_offset);
+
+void
+destroy_level_pager(Level_Pager* pager);
+
+void
+destroy_level(Level* level);
+
+Level
+instance_level(const Level& level);
+
+void
+destroy_level_instance(Level* level);
+
+void
+reserve_entities(Level& level, int count);
 
 void
 add_entity(Level& level, const Entity& entity);
 
 Entity
-create_prisoner(const Vector3& position);
-Entity
-create_scroll(const Vector3& position);
+get_entity(const Level& level, int index);
+
+void
+remove_entity(Level& level, int index);
+
+// NOTE(bill): (Re)builds `trigger_tiles` from scratch, needed whenever the
+// entity arrays are replaced wholesale
+void
+build_trigger_index(Level& level);
+
+inline b32
+has_trigger_index(const Level& l)
+{
+	return l.trigger_tiles != nullptr || l.trigger_chunks != nullptr;
+}
+
+// NOTE(bill): Every trigger on the tile, as an entity index, until `next_trigger` returns -1
+inline int
+first_trigger(const Level& l, int x, int y)
+{
+	if (x < 0 || y < 0 || x >= l.width || y >= l.height)
+		return -1;
+	if (l.trigger_tiles)
+		return l.trigger_tiles[x + y * l.width] - 1;
+	if (l.trigger_chunks == nullptr)
+		return -1;
+
+	const int* heads = l.trigger_chunks[get_chunk_index(l, x, y)];
+	return heads ? heads[get_chunk_offset(x, y)] - 1 : -1;
+}
+
+inline int
+next_trigger(const Level& l, int index)
+{
+	return l.entity_cold[index].next_trigger - 1;
+}
+
+// NOTE(bill): Positions are in entity space, the tile of a position is
+// `floor(p + 0.5)`. Sight runs between tile centres, so it is symmetric.
+b32
+has_line_of_sight(Level& level, const Vector2& from, const Vector2& to);
+
+void
+test_line_of_sight(Level& level, const Sight_Query* queries, int count, b32* visible);
+
+// NOTE(bill): A fresh entity of any type, as its archetype says
 Entity
-create_mage(const Vector3& position);
+create_entity(Entity_Type type, const Vector3& position);
+
 Entity
 create_portal(const Vector3& position, u16 portal_id, u16 other_portal_id);
-Entity
-create_boss(const Vector3& position);
 
-Entity
-create_health_potion(const Vector3& position);
-Entity
-create_mana_potion(const Vector3& position);
 #endif
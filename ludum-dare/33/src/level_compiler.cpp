@@ -0,0 +1,127 @@
+// Level Compiler
+//
+// Offline tool: turns a level image into a compiled level (see
+// `Level_File_Header`) that the game maps in place of decoding the image, or
+// with --chunked one the game streams a chunk at a time (see
+// `update_level_pager`). Loads the result back, checks it is the same level
+// and reports the load time of both. A chunked level is also walked corner to
+// corner to report what paging it costs.
+//
+// Usage: level_compiler <input.png> <output.level> [--chunked]
+
+#include "bitmap.cpp"
+#include "level.cpp"
+#include "level_manager.cpp"
+
+constexpr int LOAD_REPEATS = 16;
+
+// NOTE(bill): Same tiles, triggers, spawn and entities in the same order. A
+// chunked `b` has every chunk paged in.
+internal b32
+levels_match(const Level& a, Level& b)
+{
+	if (a.width != b.width || a.height != b.height || a.entity_count != b.entity_count)
+		return false;
+	if (a.init_position.x != b.init_position.x || a.init_position.y != b.init_position.y)
+		return false;
+
+	for (int i = 0; b.pager && i < b.chunks_x * b.chunks_y; i++)
+		page_in_level_chunk(b, i);
+
+	for (int y = 0; y < a.height; y++) {
+		for (int x = 0; x < a.width; x++) {
+			const Tile ta = get_tile(a, x, y);
+			const Tile tb = get_tile(b, x, y);
+			if (memcmp(&ta, &tb, sizeof(Tile)) != 0 || first_trigger(a, x, y) != first_trigger(b, x, y))
+				return false;
+		}
+	}
+
+	return memcmp(a.entity_hot, b.entity_hot, a.entity_count * sizeof(Entity_Hot)) == 0 &&
+	       memcmp(a.entity_cold, b.entity_cold, a.entity_count * sizeof(Entity_Cold)) == 0;
+}
+
+// NOTE(bill): Average ms per load, touching only what starting the level would
+internal f64
+time_level_load(const char* filename)
+{
+	const f64 start_time = emscripten_get_now();
+	for (int i = 0; i < LOAD_REPEATS; i++) {
+		Level level = load_level_from_file(filename);
+		destroy_level(&level);
+	}
+	return (emscripten_get_now() - start_time) / LOAD_REPEATS;
+}
+
+// NOTE(bill): One tick per tile along the diagonal, as fast as the player could
+// ever go
+internal void
+walk_chunked_level(const char* filename)
+{
+	Level level = load_level_from_file(filename);
+	if (level.pager == nullptr)
+		return;
+	defer(destroy_level(&level));
+
+	const int steps      = level.width > level.height ? level.width : level.height;
+	const f64 start_time = emscripten_get_now();
+	for (int i = 0; i < steps; i++) {
+		const Vector2 center = {(f32)i * (level.width - 1) / steps, (f32)i * (level.height - 1) / steps};
+		update_level_pager(level, center, i + 1);
+	}
+	const f64 walk_time = emscripten_get_now() - start_time;
+
+	const Level_Pager& pager = *level.pager;
+	printf("[Level] Walk: %d ticks in %.2f ms, %llu chunks loaded, %llu evicted, %llu waited on, peak %.1f KB resident of %d x %d chunks\n",
+	       steps, walk_time,
+	       (unsigned long long)pager.loads, (unsigned long long)pager.evictions, (unsigned long long)pager.waits,
+	       pager.peak_resident * LEVEL_CHUNK_BYTES / 1024.0, level.chunks_x, level.chunks_y);
+}
+
+int
+main(int argc, char** argv)
+{
+	const b32 chunked = argc == 4 && strcmp(argv[3], "--chunked") == 0;
+	if (argc != 3 && !chunked) {
+		printf("Usage: level_compiler <input.png> <output.level> [--chunked]\n");
+		return 1;
+	}
+	const char* input  = argv[1];
+	const char* output = argv[2];
+
+	Level level = load_level_from_file(input);
+	if (level.grid == nullptr)
+		return 1;
+	defer(destroy_level(&level));
+
+	if (!save_compiled_level(level, output, chunked))
+		return 1;
+
+	Level compiled = load_level_from_file(output);
+	if (!has_tiles(compiled))
+		return 1;
+	defer(destroy_level(&compiled));
+
+	if (!levels_match(level, compiled)) {
+		printf("[Level] \"%s\" does not load back the same as \"%s\"\n", output, input);
+		remove(output);
+		return 1;
+	}
+
+	int portal_count = 0;
+	for (int i = 0; i < level.entity_count; i++)
+		portal_count += level.entity_hot[i].type == ENTITY_PORTAL;
+
+	struct stat info = {};
+	stat(output, &info);
+	printf("[Level] %s -> %s: %dx%d%s, %d entities, %d portals, %llu bytes\n",
+	       input, output, level.width, level.height, chunked ? " chunked" : "",
+	       level.entity_count, portal_count, (unsigned long long)info.st_size);
+	printf("[Level] Load: image %.3f ms, compiled %.3f ms\n",
+	       time_level_load(input), time_level_load(output));
+
+	if (chunked)
+		walk_chunked_level(output);
+
+	return 0;
+}
@@ -0,0 +1,426 @@
+#include "level_manager.hpp"
+
+// NOTE(bill): Everything the first tick on the level would otherwise set up
+internal void
+load_level_proc(Level_Slot* slot)
+{
+	Arena* arena = create_arena(LEVEL_ARENA_SIZE);
+	Level level  = load_level_from_file(slot->filename, arena);
+	if (!has_tiles(level)) {
+		destroy_arena(arena);
+		slot->state.store(LEVEL_SLOT_FAILED, std::memory_order_release);
+		return;
+	}
+
+	has_line_of_sight(level, level.init_position, level.init_position); // NOTE(bill): Makes the sight cache
+
+	slot->level = level;
+	slot->state.store(LEVEL_SLOT_READY, std::memory_order_release);
+}
+
+int
+request_level(Level_Manager& manager, const char* filename)
+{
+	int free_slot = -1;
+	for (int i = 0; i < MAX_RESIDENT_LEVELS; i++) {
+		Level_Slot& slot = manager.slots[i];
+		if (slot.state.load(std::memory_order_acquire) == LEVEL_SLOT_EMPTY) {
+			if (free_slot < 0)
+				free_slot = i;
+			continue;
+		}
+		if (strcmp(slot.filename, filename) == 0)
+			return i;
+	}
+
+	if (free_slot < 0 || strlen(filename) >= MAX_LEVEL_FILENAME)
+		return -1;
+
+	Level_Slot& slot = manager.slots[free_slot];
+	strcpy(slot.filename, filename);
+	slot.level = {};
+	slot.state.store(LEVEL_SLOT_LOADING, std::memory_order_release);
+
+#if LEVEL_LOADER_THREADS
+	slot.loader = std::thread(load_level_proc, &slot);
+#else
+	load_level_proc(&slot);
+#endif
+
+	return free_slot;
+}
+
+Level*
+get_level(Level_Manager& manager, int slot_index)
+{
+	if (slot_index < 0 || slot_index >= MAX_RESIDENT_LEVELS)
+		return nullptr;
+
+	Level_Slot& slot = manager.slots[slot_index];
+	const u32 state  = slot.state.load(std::memory_order_acquire);
+	if (state == LEVEL_SLOT_LOADING)
+		return nullptr;
+
+	if (slot.loader.joinable())
+		slot.loader.join(); // NOTE(bill): Already done, does not wait
+	return state == LEVEL_SLOT_READY ? &slot.level : nullptr;
+}
+
+Level*
+wait_for_level(Level_Manager& manager, int slot_index)
+{
+	if (slot_index < 0 || slot_index >= MAX_RESIDENT_LEVELS)
+		return nullptr;
+
+	Level_Slot& slot = manager.slots[slot_index];
+	if (slot.loader.joinable())
+		slot.loader.join();
+	return get_level(manager, slot_index);
+}
+
+void
+unload_level(Level_Manager& manager, int slot_index)
+{
+	if (slot_index < 0 || slot_index >= MAX_RESIDENT_LEVELS)
+		return;
+
+	Level_Slot& slot = manager.slots[slot_index];
+	if (slot.loader.joinable())
+		slot.loader.join();
+
+	destroy_level(&slot.level); // NOTE(bill): One arena, freed in one go
+	slot.filename[0] = '\0';
+	slot.state.store(LEVEL_SLOT_EMPTY, std::memory_order_release);
+}
+
+void
+destroy_level_manager(Level_Manager* manager)
+{
+	if (manager) {
+		for (int i = 0; i < MAX_RESIDENT_LEVELS; i++)
+			unload_level(*manager, i);
+	}
+}
+
+////////////////////////////////
+// Chunk Paging
+////////////////////////////////
+
+// NOTE(bill): Anything that cannot be read is left as outside the level
+internal void
+read_level_chunk(const Level_Pager& pager, int chunk, Packed_Tile* tiles)
+{
+	u8* bytes    = (u8*)tiles;
+	size_t count = 0;
+	while (count < LEVEL_CHUNK_BYTES) {
+		const ssize_t n = pread(pager.file, bytes + count, LEVEL_CHUNK_BYTES - count,
+		                        pager.grid_offset + (u64)chunk * LEVEL_CHUNK_BYTES + count);
+		if (n <= 0)
+			break;
+		count += n;
+	}
+	memset(bytes + count, 0, LEVEL_CHUNK_BYTES - count);
+}
+
+// NOTE(bill): Needs `pager.mutex`
+internal Packed_Tile*
+take_chunk_memory(Level_Pager& pager)
+{
+	if (pager.free_count > 0)
+		return pager.free_chunks[--pager.free_count];
+	return (Packed_Tile*)malloc(LEVEL_CHUNK_BYTES);
+}
+
+internal void
+append_chunk_memory(Packed_Tile*** list, int* count, int* capacity, Packed_Tile* tiles)
+{
+	if (*count == *capacity) {
+		*capacity = *capacity ? 2 * *capacity : 64;
+		*list     = (Packed_Tile**)realloc(*list, *capacity * sizeof(Packed_Tile*));
+	}
+	(*list)[(*count)++] = tiles;
+}
+
+// NOTE(bill): Needs `pager.mutex`
+internal void
+give_chunk_memory(Level_Pager& pager, Packed_Tile* tiles)
+{
+	append_chunk_memory(&pager.free_chunks, &pager.free_count, &pager.free_capacity, tiles);
+}
+
+internal void
+level_pager_proc(Level_Pager* pager)
+{
+	for (;;) {
+		int chunk          = 0;
+		Packed_Tile* tiles = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(pager->mutex);
+			pager->work.wait(lock, [pager] { return pager->queue_head != pager->queue_tail || !pager->running; });
+			if (!pager->running)
+				return;
+			chunk = pager->queue[pager->queue_head++ & (LEVEL_PAGER_QUEUE_SIZE - 1)];
+			tiles = take_chunk_memory(*pager);
+		}
+
+		if (tiles)
+			read_level_chunk(*pager, chunk, tiles);
+
+		std::lock_guard<std::mutex> lock(pager->mutex);
+		if (tiles) {
+			pager->chunks[chunk].store(tiles, std::memory_order_release);
+			pager->done[pager->done_count++] = chunk;
+		} else {
+			pager->failed[pager->failed_count++] = chunk;
+		}
+	}
+}
+
+Level_Pager*
+create_level_pager(Level& level, int file, u64 grid_offset)
+{
+	Level_Pager* pager = new Level_Pager();
+	pager->file        = file;
+	pager->grid_offset = grid_offset;
+	pager->chunk_count = level.chunks_x * level.chunks_y;
+	pager->budget      = LEVEL_PAGER_BUDGET / LEVEL_CHUNK_BYTES;
+
+	// NOTE(bill): All zero is null
+	pager->chunks      = (std::atomic<Packed_Tile*>*)calloc(pager->chunk_count, sizeof(std::atomic<Packed_Tile*>));
+	pager->states      = (u8*)calloc(pager->chunk_count, sizeof(u8));
+	pager->dirty       = (b8*)calloc(pager->chunk_count, sizeof(b8));
+	pager->last_wanted = (u32*)calloc(pager->chunk_count, sizeof(u32));
+	pager->resident    = (int*)calloc(pager->chunk_count, sizeof(int));
+	if (!pager->chunks || !pager->states || !pager->dirty || !pager->last_wanted || !pager->resident) {
+		pager->file = -1; // NOTE(bill): Still the caller's
+		destroy_level_pager(pager);
+		return nullptr;
+	}
+
+	pager->running = true;
+#if LEVEL_LOADER_THREADS
+	pager->loader = std::thread(level_pager_proc, pager);
+#endif
+
+	level.chunks = pager->chunks;
+	level.pager  = pager;
+	return pager;
+}
+
+void
+destroy_level_pager(Level_Pager* pager)
+{
+	if (pager == nullptr)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(pager->mutex);
+		pager->running = false;
+	}
+	pager->work.notify_one();
+	if (pager->loader.joinable())
+		pager->loader.join();
+
+	for (int i = 0; pager->chunks && i < pager->chunk_count; i++)
+		free(pager->chunks[i].load(std::memory_order_relaxed));
+	for (int i = 0; i < pager->free_count; i++)
+		free(pager->free_chunks[i]);
+	for (int i = 0; i < pager->held_count; i++)
+		free(pager->held_chunks[i]);
+	if (pager->file >= 0)
+		close(pager->file);
+
+	free(pager->chunks);
+	free(pager->states);
+	free(pager->dirty);
+	free(pager->last_wanted);
+	free(pager->resident);
+	free(pager->free_chunks);
+	free(pager->held_chunks);
+	delete pager;
+}
+
+// NOTE(bill): Chunks coming and going changes what `get_tile` says, so it
+// moves `tile_version` on like `set_tile` does
+internal void
+make_chunk_resident(Level& level, int chunk)
+{
+	Level_Pager& pager  = *level.pager;
+	pager.states[chunk] = LEVEL_CHUNK_RESIDENT;
+	pager.resident[pager.resident_count++] = chunk;
+	pager.loads++;
+	if (pager.peak_resident < pager.resident_count)
+		pager.peak_resident = pager.resident_count;
+	level.tile_version++;
+}
+
+// NOTE(bill): Takes in whatever the loader has finished with
+internal void
+collect_level_chunk_loads(Level& level)
+{
+	Level_Pager& pager = *level.pager;
+
+	std::lock_guard<std::mutex> lock(pager.mutex);
+	for (int i = 0; i < pager.done_count; i++)
+		make_chunk_resident(level, pager.done[i]);
+	for (int i = 0; i < pager.failed_count; i++)
+		pager.states[pager.failed[i]] = LEVEL_CHUNK_EVICTED; // NOTE(bill): Asked for again later
+	pager.in_flight -= pager.done_count + pager.failed_count;
+	pager.done_count   = 0;
+	pager.failed_count = 0;
+}
+
+Packed_Tile*
+page_in_level_chunk(Level& level, int chunk)
+{
+	Level_Pager& pager = *level.pager;
+
+	Packed_Tile* tiles = pager.chunks[chunk].load(std::memory_order_acquire);
+	if (tiles)
+		return tiles;
+
+	pager.waits++;
+	if (pager.states[chunk] == LEVEL_CHUNK_QUEUED) {
+		// NOTE(bill): The loader has it, it is never long
+		for (;;) {
+			collect_level_chunk_loads(level);
+			if (pager.states[chunk] != LEVEL_CHUNK_QUEUED)
+				break;
+			std::this_thread::yield();
+		}
+		if (pager.states[chunk] == LEVEL_CHUNK_RESIDENT)
+			return pager.chunks[chunk].load(std::memory_order_acquire);
+		// NOTE(bill): The loader had no memory for it, try again here
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(pager.mutex);
+		tiles = take_chunk_memory(pager);
+	}
+	if (tiles == nullptr)
+		return nullptr;
+
+	read_level_chunk(pager, chunk, tiles);
+	pager.chunks[chunk].store(tiles, std::memory_order_release);
+	make_chunk_resident(level, chunk);
+	return tiles;
+}
+
+internal void
+queue_level_chunk(Level& level, int chunk)
+{
+	Level_Pager& pager = *level.pager;
+#if LEVEL_LOADER_THREADS
+	if (pager.in_flight == LEVEL_PAGER_QUEUE_SIZE)
+		return; // NOTE(bill): Asked for again next tick
+
+	pager.states[chunk] = LEVEL_CHUNK_QUEUED;
+	pager.in_flight++;
+	{
+		std::lock_guard<std::mutex> lock(pager.mutex);
+		pager.queue[pager.queue_tail++ & (LEVEL_PAGER_QUEUE_SIZE - 1)] = chunk;
+	}
+	pager.work.notify_one();
+#else
+	page_in_level_chunk(level, chunk);
+	pager.waits--; // NOTE(bill): Not a wait, there is no loader to wait on
+#endif
+}
+
+// NOTE(bill): Least recently wanted first, never one wanted this tick or dirty
+internal void
+evict_level_chunks(Level& level, u32 tick)
+{
+	Level_Pager& pager = *level.pager;
+	while (pager.resident_count > pager.budget) {
+		int oldest = -1;
+		for (int i = 0; i < pager.resident_count; i++) {
+			const int chunk = pager.resident[i];
+			if (pager.dirty[chunk] || pager.last_wanted[chunk] == tick)
+				continue;
+			if (oldest < 0 || pager.last_wanted[chunk] < pager.last_wanted[pager.resident[oldest]])
+				oldest = i;
+		}
+		if (oldest < 0)
+			break;
+
+		const int chunk          = pager.resident[oldest];
+		pager.resident[oldest]   = pager.resident[--pager.resident_count];
+		pager.states[chunk]      = LEVEL_CHUNK_EVICTED;
+		pager.evictions++;
+		level.tile_version++;
+
+		// NOTE(bill): A render snapshot may have loaded the pointer before the
+		// exchange, so the loader must not read another chunk into it yet
+		Packed_Tile* tiles = pager.chunks[chunk].exchange(nullptr, std::memory_order_acq_rel);
+		if (pager.hold_evicted) {
+			append_chunk_memory(&pager.held_chunks, &pager.held_count, &pager.held_capacity, tiles);
+			continue;
+		}
+		std::lock_guard<std::mutex> lock(pager.mutex);
+		give_chunk_memory(pager, tiles);
+	}
+}
+
+void
+release_evicted_level_chunks(Level& level)
+{
+	if (level.pager == nullptr)
+		return;
+	Level_Pager& pager = *level.pager;
+
+	std::lock_guard<std::mutex> lock(pager.mutex);
+	for (int i = 0; i < pager.held_count; i++)
+		give_chunk_memory(pager, pager.held_chunks[i]);
+	pager.held_count   = 0;
+	pager.hold_evicted = true;
+}
+
+void
+update_level_pager(Level& level, const Vector2& center, u32 tick)
+{
+	if (level.pager == nullptr)
+		return;
+	Level_Pager& pager = *level.pager;
+
+	collect_level_chunk_loads(level);
+
+	const int cx = (int)floorf(center.x + 0.5f) >> LOG2_LEVEL_CHUNK_SIZE;
+	const int cy = (int)floorf(center.y + 0.5f) >> LOG2_LEVEL_CHUNK_SIZE;
+
+	for (int radius = LEVEL_NEAR_RADIUS; radius <= LEVEL_PAGE_RADIUS; radius += LEVEL_PAGE_RADIUS - LEVEL_NEAR_RADIUS) {
+		const int x0 = cx - radius < 0 ? 0 : cx - radius;
+		const int y0 = cy - radius < 0 ? 0 : cy - radius;
+		const int x1 = cx + radius >= level.chunks_x ? level.chunks_x - 1 : cx + radius;
+		const int y1 = cy + radius >= level.chunks_y ? level.chunks_y - 1 : cy + radius;
+		for (int y = y0; y <= y1; y++) {
+			for (int x = x0; x <= x1; x++) {
+				const int chunk          = x + y * level.chunks_x;
+				pager.last_wanted[chunk] = tick;
+				if (radius == LEVEL_NEAR_RADIUS)
+					page_in_level_chunk(level, chunk);
+				else if (pager.states[chunk] == LEVEL_CHUNK_EVICTED)
+					queue_level_chunk(level, chunk);
+			}
+		}
+	}
+
+	evict_level_chunks(level, tick);
+}
+
+void
+set_chunked_tile(Level& level, Packed_Tile packed, int x, int y)
+{
+	const int chunk = get_chunk_index(level, x, y);
+
+	Packed_Tile* tiles = level.chunks[chunk].load(std::memory_order_acquire);
+	if (level.pager)
+		tiles = page_in_level_chunk(level, chunk);
+	if (tiles == nullptr)
+		return; // NOTE(bill): An instance the level does not have it resident for, or out of memory
+	if (level.pager)
+		level.pager->dirty[chunk] = true; // NOTE(bill): Evicting it would lose the write
+
+	tiles[get_chunk_offset(x, y)] = packed;
+	level.tile_version++;
+}
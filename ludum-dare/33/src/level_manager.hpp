@@ -0,0 +1,149 @@
+#ifndef LEVEL_MANAGER_HPP
+#define LEVEL_MANAGER_HPP
+
+#include "level.hpp"
+
+// NOTE(bill): Keeps several levels resident at once. A level is decoded and
+// prepared on a background thread while the game carries on with the current
+// one, so switching to it is only pointing `Game::curr_level` at it. Each
+// level lives in its own `Arena` and is released in one go when unloaded.
+
+// NOTE(bill): Builds without threads (plain emcc, no USE_PTHREADS) load in
+// `request_level` instead
+#ifndef LEVEL_LOADER_THREADS
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define LEVEL_LOADER_THREADS 0
+#else
+#define LEVEL_LOADER_THREADS 1
+#endif
+#endif
+
+constexpr int MAX_RESIDENT_LEVELS = 4;
+constexpr int MAX_LEVEL_FILENAME  = 64;
+constexpr size_t LEVEL_ARENA_SIZE = 1 << 20; // NOTE(bill): First block, grows past it as needed
+
+enum Level_Slot_State : u32 {
+	LEVEL_SLOT_EMPTY,
+	LEVEL_SLOT_LOADING, // NOTE(bill): Only the loader thread touches `level`
+	LEVEL_SLOT_READY,
+	LEVEL_SLOT_FAILED,
+};
+
+struct Level_Slot {
+	std::atomic<u32> state; // NOTE(bill): `Level_Slot_State`
+	char filename[MAX_LEVEL_FILENAME];
+	Level level;
+	std::thread loader;
+};
+
+struct Level_Manager {
+	Level_Slot slots[MAX_RESIDENT_LEVELS];
+};
+
+// NOTE(bill): Starts loading `filename` unless it is already resident and
+// returns its slot, or -1 when every slot is in use. Never blocks when
+// `LEVEL_LOADER_THREADS` is on.
+int
+request_level(Level_Manager& manager, const char* filename);
+
+// NOTE(bill): The level once it is ready to play, otherwise null. Never blocks.
+Level*
+get_level(Level_Manager& manager, int slot);
+
+// NOTE(bill): Null if it failed to load
+Level*
+wait_for_level(Level_Manager& manager, int slot);
+
+// NOTE(bill): Must not be `Game::curr_level`
+void
+unload_level(Level_Manager& manager, int slot);
+
+void
+destroy_level_manager(Level_Manager* manager);
+
+////////////////////////////////
+// Chunk Paging
+////////////////////////////////
+
+// NOTE(bill): Chunked levels (see `Level::chunks`) stream their tiles from the
+// compiled level file. Every tick `update_level_pager` wants the chunks within
+// `LEVEL_PAGE_RADIUS` of the player: the ones within `LEVEL_NEAR_RADIUS` are
+// read there and then if they have to be, the loader thread reads the rest in
+// the background. Once more than `budget` are resident the least recently
+// wanted go. Chunks written by `set_tile` are never evicted.
+constexpr int LEVEL_PAGE_RADIUS        = 3;       // NOTE(bill): In chunks, 7x7 of them are wanted
+constexpr int LEVEL_NEAR_RADIUS        = 1;       // What the player can reach before the loader gets to it
+constexpr size_t LEVEL_PAGER_BUDGET    = 8 << 20; // NOTE(bill): Bytes of resident chunks
+constexpr int LEVEL_PAGER_QUEUE_SIZE   = 256;     // Must be a power of two
+constexpr size_t LEVEL_CHUNK_BYTES     = LEVEL_CHUNK_TILES * sizeof(Packed_Tile);
+constexpr int LEVEL_PAGE_WINDOW_CHUNKS = (2 * LEVEL_PAGE_RADIUS + 1) * (2 * LEVEL_PAGE_RADIUS + 1);
+
+static_assert(LEVEL_PAGER_BUDGET / LEVEL_CHUNK_BYTES >= LEVEL_PAGE_WINDOW_CHUNKS, "LEVEL_PAGER_BUDGET must hold every wanted chunk");
+
+enum Level_Chunk_State : u8 {
+	LEVEL_CHUNK_EVICTED,
+	LEVEL_CHUNK_QUEUED, // NOTE(bill): Until the loader is seen to be done with it, see `collect_level_chunk_loads`
+	LEVEL_CHUNK_RESIDENT,
+};
+
+struct Level_Pager {
+	int file;
+	u64 grid_offset;
+	int chunk_count;
+	std::atomic<Packed_Tile*>* chunks; // NOTE(bill): Same as `Level::chunks`
+
+	// NOTE(bill): Only the thread playing the level touches these
+	u8* states;       // `Level_Chunk_State`
+	b8* dirty;        // NOTE(bill): Written by `set_tile`
+	u32* last_wanted; // Tick, the LRU order
+	int* resident;    // Chunk indices, in no order
+	int resident_count;
+	int budget; // NOTE(bill): In chunks, dirty ones can go past it
+	int in_flight;
+
+	// NOTE(bill): Evicted chunks' memory waits here instead of being reused
+	// once another thread may read the chunks, see `release_evicted_level_chunks`
+	b32 hold_evicted;
+	int held_count;
+	int held_capacity;
+	Packed_Tile** held_chunks;
+
+	// NOTE(bill): Shared with the loader, under `mutex`
+	std::mutex mutex;
+	std::condition_variable work;
+	std::thread loader;
+	b32 running;
+	u32 queue_head;
+	u32 queue_tail;
+	int queue[LEVEL_PAGER_QUEUE_SIZE];
+	int done_count;
+	int done[LEVEL_PAGER_QUEUE_SIZE];
+	int failed_count;
+	int failed[LEVEL_PAGER_QUEUE_SIZE]; // NOTE(bill): No memory to read them into, they go back to evicted
+	int free_count;
+	int free_capacity;
+	Packed_Tile** free_chunks; // NOTE(bill): Evicted chunks' memory, reused before any more is allocated
+
+	u64 loads;
+	u64 evictions;
+	u64 waits; // NOTE(bill): Near chunks the loader had not got to
+	int peak_resident;
+};
+
+// NOTE(bill): `center` in entity space, `tick` must go up every call
+void
+update_level_pager(Level& level, const Vector2& center, u32 tick);
+
+// NOTE(bill): The chunk's tiles, read there and then if it has to be. Only for
+// the thread playing the level.
+Packed_Tile*
+page_in_level_chunk(Level& level, int chunk);
+
+// NOTE(bill): For when another thread reads the level's chunks, i.e. renders a
+// snapshot of it. From the first call on, the memory of evicted chunks is not
+// reused until the next call, so calls must only come once nothing can still
+// be reading what was evicted before them, and never while the level updates.
+void
+release_evicted_level_chunks(Level& level);
+
+#endif
@@ -0,0 +1,136 @@
+// Level Switch Check
+//
+// Headless unity build: plays one level while the level manager loads another
+// in the background, switches to it once `get_level` has it, and reports the
+// longest tick before, during and after the load. Ticks come at the game's
+// rate, as in play. The load should not show up in any of them, only in how
+// many ticks it took.
+//
+// Usage: level_switch_check [current] [next]
+
+#include "bitmap.cpp"
+#include "level.cpp"
+#include "level_manager.cpp"
+#include "game.cpp"
+
+constexpr int SETTLE_TICKS   = 60;
+constexpr int MAX_LOAD_TICKS = 60 * 60; // NOTE(bill): A minute of play, then it gives up
+
+struct Tick_Stats {
+	int ticks;
+	f64 total_time; // NOTE(bill): ms
+	f64 max_time;
+};
+
+// NOTE(bill): Walks forward and turns every so often, saving what a frame
+// would blend from before each tick like main.cpp does
+internal void
+run_tick(Game& game, u8* keys, Tick_History* history, Tick_Stats* stats)
+{
+	local_persist f64 next_tick_time = 0;
+	const f64 now                    = emscripten_get_now();
+	if (now < next_tick_time)
+		usleep((useconds_t)(1000.0 * (next_tick_time - now)));
+	next_tick_time = emscripten_get_now() + 1000.0 * TIME_STEP;
+
+	keys[SDLK_UP]   = true;
+	keys[SDLK_LEFT] = (game.tick / 45) % 3 == 0;
+
+	save_tick_history(game, history);
+
+	const f64 start_time = emscripten_get_now();
+	update_game(game, TIME_STEP);
+	const f64 tick_time = emscripten_get_now() - start_time;
+
+	stats->ticks++;
+	stats->total_time += tick_time;
+	if (stats->max_time < tick_time)
+		stats->max_time = tick_time;
+}
+
+internal void
+print_tick_stats(const char* name, const Tick_Stats& stats)
+{
+	printf("[Switch] %-7s %5d ticks, average %.3f ms, longest %.3f ms\n",
+	       name, stats.ticks, stats.ticks ? stats.total_time / stats.ticks : 0, stats.max_time);
+}
+
+int
+main(int argc, char** argv)
+{
+	const char* curr_filename = argc > 1 ? argv[1] : "level001.png";
+	const char* next_filename = argc > 2 ? argv[2] : "level001.level";
+
+	local_persist u8 keys[MAX_KEYS] = {};
+	local_persist Game game         = {};
+	game.keys     = keys;
+	game.headless = true;
+	game.levels   = new Level_Manager();
+	defer(shutdown(game));
+	seed_game_random(game, 0x1d33);
+
+	const int curr_slot = request_level(*game.levels, curr_filename);
+	game.curr_level     = wait_for_level(*game.levels, curr_slot);
+	if (game.curr_level == nullptr) {
+		printf("[Switch] Could not load \"%s\"\n", curr_filename);
+		return 1;
+	}
+	reset_player(game);
+	game.player.max_health = game.player.health = 1e9f; // NOTE(bill): Keep playing whatever happens
+
+	Tick_History history = {};
+	defer(destroy_tick_history(&history));
+
+	Tick_Stats before = {};
+	for (int i = 0; i < SETTLE_TICKS; i++)
+		run_tick(game, keys, &history, &before);
+
+	// NOTE(bill): Load in the background, playing on until it is ready
+	const f64 load_start = emscripten_get_now();
+	const int next_slot  = request_level(*game.levels, next_filename);
+	if (next_slot < 0 || next_slot == curr_slot) {
+		printf("[Switch] \"%s\" needs a slot of its own\n", next_filename);
+		return 1;
+	}
+
+	Tick_Stats during = {};
+	Level* next       = nullptr;
+	while ((next = get_level(*game.levels, next_slot)) == nullptr) {
+		if (game.levels->slots[next_slot].state.load(std::memory_order_acquire) == LEVEL_SLOT_FAILED) {
+			printf("[Switch] Could not load \"%s\"\n", next_filename);
+			return 1;
+		}
+		if (during.ticks == MAX_LOAD_TICKS) {
+			printf("[Switch] \"%s\" still not loaded after %d ticks\n", next_filename, during.ticks);
+			return 1;
+		}
+		run_tick(game, keys, &history, &during);
+	}
+	const f64 load_time = emscripten_get_now() - load_start;
+
+	const f64 switch_start = emscripten_get_now();
+	switch_level(game, next, &history);
+	unload_level(*game.levels, curr_slot);
+	const f64 switch_time = emscripten_get_now() - switch_start;
+
+	const b32 switched = game.curr_level == next &&
+	                     game.particle_count == 0 &&
+	                     history.entity_count == next->entity_count &&
+	                     game.player.x == next->init_position.x && game.player.y == next->init_position.y;
+
+	Tick_Stats after = {};
+	for (int i = 0; i < SETTLE_TICKS; i++)
+		run_tick(game, keys, &history, &after);
+
+	printf("[Switch] %s -> %s: loaded in %.2f ms over %d ticks, switched and unloaded in %.3f ms\n",
+	       curr_filename, next_filename, load_time, during.ticks, switch_time);
+	print_tick_stats("before", before);
+	print_tick_stats("loading", during);
+	print_tick_stats("after", after);
+
+	if (!switched) {
+		printf("[Switch] The switch left state from \"%s\" behind\n", curr_filename);
+		return 1;
+	}
+	return 0;
+}
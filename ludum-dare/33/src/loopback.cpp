@@ -0,0 +1,158 @@
+// Loopback Multiplayer Test
+//
+// Headless unity build: one authoritative server playing level001.png with a
+// scripted player, streaming to several clients over loopback channels with
+// different latencies and packet loss. Every decoded snapshot is checked
+// against the server's copy and the bandwidth and CPU cost per client is reported.
+//
+// Usage: loopback [ticks] [clients] [send_interval]
+
+#include "bitmap.cpp"
+#include "level.cpp"
+#include "level_manager.cpp"
+#include "game.cpp"
+#include "net.cpp"
+
+internal void
+script_keys(u8* keys, u32 tick)
+{
+	keys[SDLK_UP]   = true;
+	keys[SDLK_LEFT] = ((tick / 90) % 3) == 0;
+}
+
+internal b32
+snapshots_match(const Net_Snapshot& a, const Net_Snapshot& b)
+{
+	if (a.tick != b.tick ||
+	    a.entity_count != b.entity_count ||
+	    a.particle_first != b.particle_first ||
+	    a.particle_count != b.particle_count)
+		return false;
+
+	return memcmp(&a.player, &b.player, sizeof(Net_Player)) == 0 &&
+	       memcmp(a.entities, b.entities, a.entity_count * sizeof(Net_Entity)) == 0 &&
+	       memcmp(a.particles, b.particles, a.particle_count * sizeof(Net_Particle)) == 0;
+}
+
+int
+main(int argc, char** argv)
+{
+	const int ticks         = argc > 1 ? atoi(argv[1]) : 3600;
+	const int client_count  = argc > 2 ? atoi(argv[2]) : 4;
+	const int send_interval = argc > 3 ? atoi(argv[3]) : 3;
+
+	if (client_count < 1 || client_count > NET_MAX_CLIENTS) {
+		fprintf(stderr, "[Loopback] Client count must be in 1..%d\n", NET_MAX_CLIENTS);
+		return 1;
+	}
+
+	local_persist u8 keys[MAX_KEYS] = {};
+
+	Game game = {};
+
+	game.level001 = load_level_from_file("level001.png");
+	if (game.level001.grid == nullptr)
+		return 1;
+	defer(destroy_level(&game.level001));
+	game.curr_level = &game.level001;
+	game.keys       = keys;
+	game.headless   = true;
+	seed_game_random(game, 0x1d33);
+
+	reset_player(game);
+	game.player.max_health = game.player.health = 1e9f; // NOTE(bill): Keep the world moving
+
+	Server* server = (Server*)calloc(1, sizeof(Server));
+	defer({ destroy_server(server); free(server); });
+	server->game          = &game;
+	server->send_interval = send_interval;
+
+	Client* clients = (Client*)calloc(client_count, sizeof(Client));
+	defer({
+		for (int i = 0; i < client_count; i++)
+			destroy_client(&clients[i]);
+		free(clients);
+	});
+
+	for (int i = 0; i < client_count; i++) {
+		// NOTE(bill): Client 0 is perfect, the rest get worse
+		const int latency       = i;
+		const int drop_interval = i >= 2 ? 7 - i % 4 : 0;
+		clients[i].connection   = connect_client(*server, latency, drop_interval);
+	}
+
+	// NOTE(bill): Client 0 renders an interpolated view; the grid and its looks are shared read-only
+	Level view_level = {};
+	view_level.width      = game.level001.width;
+	view_level.height     = game.level001.height;
+	view_level.blocks_x   = game.level001.blocks_x;
+	view_level.grid       = game.level001.grid;
+	view_level.look_count = game.level001.look_count;
+	memcpy(view_level.looks, game.level001.looks, sizeof(view_level.looks));
+	defer({ free(view_level.entity_hot); free(view_level.entity_cold); });
+
+	Game view       = {};
+	view.curr_level = &view_level;
+
+	u32 mismatches  = 0;
+	f64 client_time = 0;
+	f64 sim_time    = 0;
+
+	for (int tick = 0; tick < ticks; tick++) {
+		script_keys(keys, tick);
+		game.has_finished = false;
+		game.curr_time    = (u32)(1000.0f * tick * TIME_STEP);
+
+		const f64 start_time = emscripten_get_now();
+		update_server(*server, TIME_STEP);
+		sim_time += emscripten_get_now() - start_time;
+
+		const f64 client_start = emscripten_get_now();
+		for (int i = 0; i < client_count; i++) {
+			Client& c = clients[i];
+			update_client(c);
+
+			if (c.latest_tick == 0)
+				continue;
+
+			const Net_Snapshot& ours   = c.history[c.latest_tick & (NET_SNAPSHOT_HISTORY - 1)];
+			const Net_Snapshot& theirs = server->history[c.latest_tick & (NET_SNAPSHOT_HISTORY - 1)];
+			if (theirs.tick == c.latest_tick && !snapshots_match(ours, theirs)) {
+				if (mismatches == 0)
+					printf("[Loopback] Client %d diverged at tick %u\n", i, c.latest_tick);
+				mismatches++;
+			}
+		}
+		client_time += emscripten_get_now() - client_start;
+
+		const f32 lag = (f32)(2 * send_interval + clients[0].connection->to_client.latency);
+		interpolate_client(clients[0], (f32)clients[0].tick - lag, view);
+	}
+
+	Byte_Buffer full = {};
+	defer(destroy_byte_buffer(&full));
+	encode_snapshot(server->history[server->tick & (NET_SNAPSHOT_HISTORY - 1)], nullptr, full);
+
+	const u32 snapshot_count = ticks / (send_interval > 0 ? send_interval : 1);
+	sim_time -= server->net_time;
+
+	printf("[Loopback] %d ticks, %d clients, snapshot every %d ticks, %d entities\n",
+	       ticks, client_count, send_interval, game.level001.entity_count);
+	printf("[Loopback] Full snapshot: %d bytes\n", full.size);
+	for (int i = 0; i < client_count; i++) {
+		const Server_Client& c = *clients[i].connection;
+		printf("[Loopback] Client %d: latency %d, drop interval %d, %.1f bytes/snapshot, %.2f KiB/s\n",
+		       i, c.to_client.latency, c.to_client.drop_interval,
+		       (f64)c.to_client.bytes_sent / snapshot_count,
+		       c.to_client.bytes_sent / (ticks * TIME_STEP) / 1024.0);
+	}
+	printf("[Loopback] Encoded %.1f bytes/snapshot for all clients (shared baselines)\n",
+	       (f64)server->encoded_bytes / snapshot_count);
+	printf("[Loopback] Server: %.3f us/tick simulating, %.3f us/tick/client capturing and encoding\n",
+	       1000.0 * sim_time / ticks, 1000.0 * server->net_time / ticks / client_count);
+	printf("[Loopback] Clients: %.3f us/tick/client decoding\n",
+	       1000.0 * client_time / ticks / client_count);
+	printf("[Loopback] %u mismatched snapshots\n", mismatches);
+
+	return mismatches == 0 ? 0 : 1;
+}
@@ -1,4 +1,56 @@
 #include "game.hpp"
+#include "replay.hpp"
+
+// NOTE(bill): With 1 the simulation of the next frame runs on its own thread
+// while this frame renders, at the cost of one frame of latency. With 0 both
+// run one after the other on the main thread. Builds without threads (plain
+// emcc, no USE_PTHREADS) always use 0.
+#ifndef FRAME_LATENCY
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define FRAME_LATENCY 0
+#else
+#define FRAME_LATENCY 1
+#endif
+#endif
+
+// NOTE(bill): Only the input stream of a live session is kept, a few bytes a
+// minute; `build_replay_keyframes` rebuilds the keyframes after loading it.
+// Saved on F5 and on exit.
+global Replay replay;
+global const char* LIVE_REPLAY_FILENAME = "last.replay";
+
+// NOTE(bill): `prev_tick` is the state before the last tick ran, `curr_tick`
+// holds the real state while the blended one is on screen
+global Tick_History prev_tick;
+global Tick_History curr_tick;
+
+// NOTE(bill): Everything a frame renders from, copied out of the game once the
+// simulation for it is done. Rendering never touches the live game.
+struct Render_Snapshot {
+	Game view;
+	Level level; // NOTE(bill): Shares the grid, owns a copy of `entity_hot`
+};
+
+// NOTE(bill): The main thread hands the sim thread a job (ticks to run, keys)
+// and renders `snapshots[front]` while the sim thread fills the other one
+struct Pipeline {
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable job_ready;
+	std::condition_variable job_done;
+
+	b32 running;
+	b32 has_job;
+
+	int tick_count;
+	f32 alpha;
+	u8 keys[MAX_KEYS];
+
+	Render_Snapshot snapshots[2];
+	int front;
+};
+
+global Pipeline pipeline;
 
 internal void
 render(Game& game)
@@ -14,21 +66,40 @@ render(Game& game)
 
 	clear_buffers(game.display, BLACK);
 
-	render_level(game);
-
-	apply_post_fx(game.display, 0.3f);
+	const Camera camera = make_camera(game.player, game.display.width, game.display.height);
+	render_level(game, camera, 0.3f);
 
 	render_ui(game);
 }
 
 internal void
-update(Game& game, f32 dt)
+render_blended(Game& game, f32 alpha)
+{
+	save_tick_history(game, &curr_tick);
+	blend_tick_history(game, prev_tick, alpha);
+	defer(load_tick_history(game, curr_tick));
+
+	render(game);
+}
+
+internal void
+update(Game& game, const u8* keys, f32 dt)
 {
-	game.keys = SDL_GetKeyboardState(nullptr);
+	game.keys = keys;
+
+	if (game.replay)
+		record_replay_tick(*game.replay, game, game.keys);
 
 	update_game(game, dt);
 }
 
+internal void
+save_live_replay(Game& game)
+{
+	if (game.replay && save_replay_to_file(*game.replay, LIVE_REPLAY_FILENAME))
+		printf("Saved %u ticks to \"%s\"\n", game.replay->tick_count, LIVE_REPLAY_FILENAME);
+}
+
 void
 handle_events(Game& game)
 {
@@ -38,6 +109,8 @@ handle_events(Game& game)
 			game.running = false;
 			break;
 		}
+		if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F5)
+			save_live_replay(game);
 		if (event.type == SDL_WINDOWEVENT) {
 			switch (event.window.event) {
 			case SDL_WINDOWEVENT_FOCUS_LOST: {
@@ -53,40 +126,32 @@ handle_events(Game& game)
 	}
 }
 
-extern "C" void
-main_loop(void* game_ptr)
+// NOTE(bill): Takes the elapsed wall clock time into the accumulator and
+// returns how many ticks to run for it, dropping any beyond the cap
+internal int
+advance_clock(Game& game)
 {
-	if (game_ptr == nullptr) {
-		printf("[ERROR] Game pointer passed to main_loop is null\n");
-		return;
-	}
-	Game& game = *(Game*)game_ptr;
-
-	handle_events(game);
+	game.prev_time = game.curr_time;
+	game.curr_time = SDL_GetTicks();
+	if (game.curr_time < game.prev_time)
+		game.curr_time = game.prev_time;
+	game.accumulator += 0.001 * (game.curr_time - game.prev_time);
 
-	if (!game.running) {
-		printf("Exiting...\n");
-		emscripten_force_exit(0);
-		return;
+	int tick_count = (int)(game.accumulator / TIME_STEP);
+	if (tick_count > MAX_TICKS_PER_FRAME) {
+		const int dropped = tick_count - MAX_TICKS_PER_FRAME;
+		game.accumulator -= dropped * TIME_STEP;
+		game.dropped_ticks += dropped;
+		game.capped_frames++;
+		tick_count = MAX_TICKS_PER_FRAME;
 	}
 
+	return tick_count;
+}
 
-	if (game.has_focus || true) {
-		game.prev_time = game.curr_time;
-		game.curr_time = SDL_GetTicks();
-		if (game.curr_time < game.prev_time)
-			game.curr_time = game.prev_time;
-		game.accumulator += 0.001 * (game.curr_time - game.prev_time);
-
-		while (game.accumulator >= TIME_STEP) {
-			game.accumulator -= TIME_STEP;
-			handle_events(game);
-			update(game, TIME_STEP);
-		}
-	}
-
-	render(game);
-
+internal void
+update_frame_stats(Game& game)
+{
 	local_persist char fps_buffer[8] = {0};
 	game.frame_count++;
 	if (game.curr_time - game.frame_time >= 1000) {
@@ -95,12 +160,196 @@ main_loop(void* game_ptr)
 		snprintf(fps_buffer, 8,
 		         "%.1f ms", ms);
 
+		if (game.dropped_ticks != game.dropped_ticks_logged) {
+			printf("[Timing] Dropped %u ticks (%.0f ms) over %u slow frames, %llu in total\n",
+			       (u32)(game.dropped_ticks - game.dropped_ticks_logged),
+			       1000.0f * TIME_STEP * (game.dropped_ticks - game.dropped_ticks_logged),
+			       game.capped_frames, (unsigned long long)game.dropped_ticks);
+			game.dropped_ticks_logged = game.dropped_ticks;
+			game.capped_frames        = 0;
+		}
+
 		game.fps = game.frame_count;
 		game.frame_count = 0;
 		game.frame_time  = SDL_GetTicks();
 	}
 }
 
+////////////////////////////////
+// Pipelined Frames
+////////////////////////////////
+
+internal void
+take_render_snapshot(const Game& game, Render_Snapshot* snapshot)
+{
+	const Level& level = *game.curr_level;
+
+	Entity_Hot* entities = snapshot->level.entity_hot;
+	int entity_capacity  = snapshot->level.entity_capacity;
+	if (entity_capacity < level.entity_count) {
+		entity_capacity = level.entity_count;
+		entities        = (Entity_Hot*)realloc(entities, entity_capacity * sizeof(Entity_Hot));
+	}
+	memcpy(entities, level.entity_hot, level.entity_count * sizeof(Entity_Hot));
+
+	snapshot->level                 = level;
+	snapshot->level.entity_hot      = entities;
+	snapshot->level.entity_cold     = nullptr; // NOTE(bill): Rendering only reads the hot half
+	snapshot->level.entity_capacity = entity_capacity;
+	snapshot->level.sight_cache     = nullptr; // NOTE(bill): Still the sim thread's
+	snapshot->level.trigger_tiles   = nullptr;
+	snapshot->level.arena           = nullptr; // NOTE(bill): Still the level manager's
+	snapshot->level.file_view       = nullptr;
+	snapshot->level.pager           = nullptr;
+	snapshot->level.trigger_chunks  = nullptr;
+
+	snapshot->view             = game;
+	snapshot->view.curr_level  = &snapshot->level;
+	snapshot->view.keys        = nullptr;
+	snapshot->view.replay      = nullptr;
+	snapshot->view.event_count = 0;
+}
+
+internal void
+sim_thread_proc(Game* game_ptr)
+{
+	Game& game = *game_ptr;
+
+	std::unique_lock<std::mutex> lock(pipeline.mutex);
+	for (;;) {
+		pipeline.job_ready.wait(lock, [] { return pipeline.has_job || !pipeline.running; });
+		if (!pipeline.running)
+			break;
+
+		// NOTE(bill): The main thread does not touch the game or the back
+		// snapshot until the job is done, no need to hold the lock
+		lock.unlock();
+
+		for (int i = 0; i < pipeline.tick_count; i++) {
+			if (i == pipeline.tick_count - 1)
+				save_tick_history(game, &prev_tick);
+			update(game, pipeline.keys, TIME_STEP);
+		}
+
+		Render_Snapshot& back = pipeline.snapshots[1 - pipeline.front];
+		take_render_snapshot(game, &back);
+		blend_tick_history(back.view, prev_tick, pipeline.alpha);
+
+		lock.lock();
+		pipeline.has_job = false;
+		pipeline.job_done.notify_one();
+	}
+}
+
+internal void
+wait_for_sim()
+{
+	std::unique_lock<std::mutex> lock(pipeline.mutex);
+	pipeline.job_done.wait(lock, [] { return !pipeline.has_job; });
+}
+
+internal void
+start_pipeline(Game& game)
+{
+	take_render_snapshot(game, &pipeline.snapshots[0]);
+	take_render_snapshot(game, &pipeline.snapshots[1]);
+	pipeline.front   = 0;
+	pipeline.running = true;
+	pipeline.has_job = false;
+	pipeline.thread  = std::thread(sim_thread_proc, &game);
+}
+
+internal void
+stop_pipeline()
+{
+	if (!pipeline.running)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(pipeline.mutex);
+		pipeline.running = false;
+		pipeline.job_ready.notify_one();
+	}
+	pipeline.thread.join();
+}
+
+// NOTE(bill): Frame N renders what the sim thread made during frame N-1 while
+// it makes frame N+1's
+internal void
+pipelined_frame(Game& game)
+{
+	wait_for_sim();
+	pipeline.front = 1 - pipeline.front;
+
+	// NOTE(bill): The last frame has rendered, nothing reads chunks evicted
+	// before now any more
+	release_evicted_level_chunks(*game.curr_level);
+
+	update_audio(game);
+	update_frame_stats(game);
+
+	const int tick_count = advance_clock(game);
+	game.accumulator -= tick_count * TIME_STEP;
+
+	{
+		std::lock_guard<std::mutex> lock(pipeline.mutex);
+		pipeline.tick_count = tick_count;
+		pipeline.alpha      = game.accumulator / TIME_STEP;
+		memcpy(pipeline.keys, SDL_GetKeyboardState(nullptr), MAX_KEYS);
+		pipeline.has_job = true;
+		pipeline.job_ready.notify_one();
+	}
+
+	render(pipeline.snapshots[pipeline.front].view);
+}
+
+////////////////////////////////
+
+internal void
+serial_frame(Game& game)
+{
+	const int tick_count = advance_clock(game);
+	for (int i = 0; i < tick_count; i++) {
+		game.accumulator -= TIME_STEP;
+		if (i == tick_count - 1)
+			save_tick_history(game, &prev_tick);
+		handle_events(game);
+		update(game, SDL_GetKeyboardState(nullptr), TIME_STEP);
+	}
+
+	update_audio(game);
+	render_blended(game, game.accumulator / TIME_STEP);
+	update_frame_stats(game);
+}
+
+extern "C" void
+main_loop(void* game_ptr)
+{
+	if (game_ptr == nullptr) {
+		printf("[ERROR] Game pointer passed to main_loop is null\n");
+		return;
+	}
+	Game& game = *(Game*)game_ptr;
+
+	if (FRAME_LATENCY > 0)
+		wait_for_sim(); // NOTE(bill): `handle_events` writes to the game
+	handle_events(game);
+
+	if (!game.running) {
+		stop_pipeline();
+		save_live_replay(game);
+		shutdown(game);
+		printf("Exiting...\n");
+		emscripten_force_exit(0);
+		return;
+	}
+
+	if (FRAME_LATENCY > 0)
+		pipelined_frame(game);
+	else
+		serial_frame(game);
+}
+
 int
 main(int argc, char** argv)
 {
@@ -111,7 +360,17 @@ main(int argc, char** argv)
 		return 1;
 	}
 
+	begin_replay(replay, game, (u32)time(nullptr), false);
+	game.replay = &replay;
+
+	save_tick_history(game, &prev_tick);
+	if (FRAME_LATENCY > 0)
+		start_pipeline(game);
+
 	emscripten_set_main_loop_arg(main_loop, (void*)&game, 0, true);
 
+	stop_pipeline();
+	save_live_replay(game);
+	shutdown(game);
 	return 0;
 }
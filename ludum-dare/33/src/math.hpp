@@ -56,10 +56,90 @@ abs(s32 v)
 	return (v + mask) ^ mask;
 }
 
+// NOTE(bill): Parabolic approximation with one refinement step, within ~1e-3
+// of sinf for any input. Only for looks (bobbing and the like), never for
+// the camera.
 inline f32
-random(f32 min, f32 max)
+fast_sin(f32 x)
 {
-	return (f32)(rand() / (f32)RAND_MAX) * (max - min) + min;
+	constexpr f32 B = 4.0f / (TAU / 2);
+	constexpr f32 C = -4.0f / ((TAU / 2) * (TAU / 2));
+
+	x = x - TAU * floorf(x * (1.0f / TAU) + 0.5f); // NOTE(bill): [-TAU/2, TAU/2]
+
+	const f32 y = B * x + C * x * abs(x);
+	return 0.225f * (y * abs(y) - y) + y;
+}
+
+inline f32
+fast_cos(f32 x)
+{
+	return fast_sin(x + TAU / 4);
+}
+
+////////////////////////////////
+// Random Series
+////////////////////////////////
+
+// NOTE(bill): PCG32 (pcg-random.org), plain data so it can be saved and
+// restored with the game. Every `stream` with the same seed gives an
+// independent sequence, so each subsystem (and thread) gets its own series
+// and the rolls of one never shift the rolls of another.
+struct Random_Series {
+	u64 state;
+	u64 inc;
+};
+
+inline u32
+random_u32(Random_Series& series)
+{
+	const u64 old = series.state;
+	series.state  = old * 6364136223846793005ull + series.inc;
+
+	const u32 xorshifted = (u32)(((old >> 18) ^ old) >> 27);
+	const u32 rot        = (u32)(old >> 59);
+	return (xorshifted >> rot) | (xorshifted << ((0u - rot) & 31));
+}
+
+inline Random_Series
+random_series(u64 seed, u64 stream = 0)
+{
+	Random_Series series = {0, (stream << 1) | 1};
+	random_u32(series);
+	series.state += seed;
+	random_u32(series);
+	return series;
+}
+
+// NOTE(bill): [0, 1)
+inline f32
+random_unit(Random_Series& series)
+{
+	return (random_u32(series) >> 8) * (1.0f / 16777216.0f);
+}
+
+// NOTE(bill): Same values as calling `random_unit` `count` times. The
+// generator is serial, but converting a block at a time keeps the float
+// conversion out of the dependency chain and lets it vectorize.
+inline void
+random_units(Random_Series& series, f32* out, int count)
+{
+	u32 bits[16];
+	while (count > 0) {
+		const int n = count < 16 ? count : 16;
+		for (int i = 0; i < n; i++)
+			bits[i] = random_u32(series);
+		for (int i = 0; i < n; i++)
+			out[i] = (bits[i] >> 8) * (1.0f / 16777216.0f);
+		out += n;
+		count -= n;
+	}
+}
+
+inline f32
+random(Random_Series& series, f32 min, f32 max)
+{
+	return random_unit(series) * (max - min) + min;
 }
 
 ////////////////////////////////
@@ -0,0 +1,234 @@
+#ifndef MATH_BATCH_HPP
+#define MATH_BATCH_HPP
+
+#include "math.hpp"
+
+// NOTE(bill): Kernels over packed arrays (one array per component) instead of
+// one `Vector2`/`Vector3` at a time. Four lanes at a time with SSE, which is
+// also what emcc maps to wasm SIMD with -msimd128; the tail and builds without
+// SSE use the scalar loop, which gives the same results.
+// No alignment is needed on any of the arrays.
+
+#if defined(__SSE__) // NOTE(bill): <xmmintrin.h> is in common.hpp
+#define MATH_BATCH_SSE 1
+#else
+#define MATH_BATCH_SSE 0
+#endif
+
+// NOTE(bill): out[i] = dot(a[i], b[i])
+inline void
+batch_dot(const f32* ax, const f32* ay, const f32* bx, const f32* by, f32* out, int count)
+{
+	int i = 0;
+#if MATH_BATCH_SSE
+	for (; i + 4 <= count; i += 4) {
+		const __m128 x = _mm_mul_ps(_mm_loadu_ps(ax + i), _mm_loadu_ps(bx + i));
+		const __m128 y = _mm_mul_ps(_mm_loadu_ps(ay + i), _mm_loadu_ps(by + i));
+		_mm_storeu_ps(out + i, _mm_add_ps(x, y));
+	}
+#endif
+	for (; i < count; i++)
+		out[i] = ax[i] * bx[i] + ay[i] * by[i];
+}
+
+// NOTE(bill): In place, x[i] = x[i] * scale + offset
+inline void
+batch_remap(f32* x, int count, f32 scale, f32 offset)
+{
+	int i = 0;
+#if MATH_BATCH_SSE
+	const __m128 s = _mm_set1_ps(scale);
+	const __m128 o = _mm_set1_ps(offset);
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_ps(x + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(x + i), s), o));
+#endif
+	for (; i < count; i++)
+		x[i] = x[i] * scale + offset;
+}
+
+// NOTE(bill): out[i] = length({x[i], y[i]})
+inline void
+batch_length(const f32* x, const f32* y, f32* out, int count)
+{
+	int i = 0;
+#if MATH_BATCH_SSE
+	for (; i + 4 <= count; i += 4) {
+		const __m128 vx = _mm_loadu_ps(x + i);
+		const __m128 vy = _mm_loadu_ps(y + i);
+		_mm_storeu_ps(out + i, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy))));
+	}
+#endif
+	for (; i < count; i++)
+		out[i] = sqrtf(x[i] * x[i] + y[i] * y[i]);
+}
+
+// NOTE(bill): In place, zero length vectors stay zero like `normalize`
+inline void
+batch_normalize(f32* x, f32* y, int count)
+{
+	int i = 0;
+#if MATH_BATCH_SSE
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one  = _mm_set1_ps(1.0f);
+	for (; i + 4 <= count; i += 4) {
+		const __m128 vx   = _mm_loadu_ps(x + i);
+		const __m128 vy   = _mm_loadu_ps(y + i);
+		const __m128 len  = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)));
+		const __m128 mask = _mm_cmpgt_ps(len, zero);
+		const __m128 inv  = _mm_and_ps(mask, _mm_div_ps(one, len));
+		_mm_storeu_ps(x + i, _mm_mul_ps(vx, inv));
+		_mm_storeu_ps(y + i, _mm_mul_ps(vy, inv));
+	}
+#endif
+	for (; i < count; i++) {
+		const f32 len = sqrtf(x[i] * x[i] + y[i] * y[i]);
+		const f32 inv = len > 0 ? 1.0f / len : 0;
+		x[i] *= inv;
+		y[i] *= inv;
+	}
+}
+
+// NOTE(bill): out[i] = length_squared(p[i] - point)
+inline void
+batch_distance_squared(const f32* x, const f32* y, const f32* z, int count, const Vector3& point, f32* out)
+{
+	int i = 0;
+#if MATH_BATCH_SSE
+	const __m128 px = _mm_set1_ps(point.x);
+	const __m128 py = _mm_set1_ps(point.y);
+	const __m128 pz = _mm_set1_ps(point.z);
+	for (; i + 4 <= count; i += 4) {
+		const __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + i), px);
+		const __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + i), py);
+		const __m128 dz = _mm_sub_ps(_mm_loadu_ps(z + i), pz);
+		const __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		_mm_storeu_ps(out + i, d2);
+	}
+#endif
+	for (; i < count; i++) {
+		const f32 dx = x[i] - point.x;
+		const f32 dy = y[i] - point.y;
+		const f32 dz = z[i] - point.z;
+		out[i]       = dx * dx + dy * dy + dz * dz;
+	}
+}
+
+// NOTE(bill): Writes the index of every point closer than `radius` to `point`
+// into `indices`, in order, and returns how many there are
+inline int
+batch_within(const f32* x, const f32* y, const f32* z, int count, const Vector3& point, f32 radius, int* indices)
+{
+	const f32 radius_2 = radius * radius;
+
+	int found = 0;
+	int i     = 0;
+#if MATH_BATCH_SSE
+	const __m128 px = _mm_set1_ps(point.x);
+	const __m128 py = _mm_set1_ps(point.y);
+	const __m128 pz = _mm_set1_ps(point.z);
+	const __m128 r2 = _mm_set1_ps(radius_2);
+	for (; i + 4 <= count; i += 4) {
+		const __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + i), px);
+		const __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + i), py);
+		const __m128 dz = _mm_sub_ps(_mm_loadu_ps(z + i), pz);
+		const __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+		int mask = _mm_movemask_ps(_mm_cmplt_ps(d2, r2));
+		for (int lane = 0; mask; lane++, mask >>= 1) {
+			if (mask & 1)
+				indices[found++] = i + lane;
+		}
+	}
+#endif
+	for (; i < count; i++) {
+		const f32 dx = x[i] - point.x;
+		const f32 dy = y[i] - point.y;
+		const f32 dz = z[i] - point.z;
+		if (dx * dx + dy * dy + dz * dz < radius_2)
+			indices[found++] = i;
+	}
+
+	return found;
+}
+
+// NOTE(bill): Writes the index of every point on the ground plane that is in
+// front of `eye` and inside the view cone, where the cone's edges are `slope`
+// to the side per unit forwards, widened by `margin` for the point's size.
+// Returns how many there are.
+inline int
+batch_view_cone(const f32* x, const f32* y, int count,
+                const Vector2& eye, const Vector2& forwards, const Vector2& sidewards,
+                f32 slope, f32 margin, int* indices)
+{
+	int found = 0;
+	int i     = 0;
+#if MATH_BATCH_SSE
+	const __m128 ex   = _mm_set1_ps(eye.x);
+	const __m128 ey   = _mm_set1_ps(eye.y);
+	const __m128 fx   = _mm_set1_ps(forwards.x);
+	const __m128 fy   = _mm_set1_ps(forwards.y);
+	const __m128 sx   = _mm_set1_ps(sidewards.x);
+	const __m128 sy   = _mm_set1_ps(sidewards.y);
+	const __m128 k    = _mm_set1_ps(slope);
+	const __m128 m    = _mm_set1_ps(margin);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	for (; i + 4 <= count; i += 4) {
+		const __m128 dx    = _mm_sub_ps(_mm_loadu_ps(x + i), ex);
+		const __m128 dy    = _mm_sub_ps(_mm_loadu_ps(y + i), ey);
+		const __m128 depth = _mm_add_ps(_mm_mul_ps(dx, fx), _mm_mul_ps(dy, fy));
+		const __m128 side  = _mm_andnot_ps(sign, _mm_add_ps(_mm_mul_ps(dx, sx), _mm_mul_ps(dy, sy)));
+		const __m128 in    = _mm_and_ps(_mm_cmpgt_ps(depth, zero),
+		                                _mm_cmplt_ps(side, _mm_add_ps(_mm_mul_ps(depth, k), m)));
+
+		int mask = _mm_movemask_ps(in);
+		for (int lane = 0; mask; lane++, mask >>= 1) {
+			if (mask & 1)
+				indices[found++] = i + lane;
+		}
+	}
+#endif
+	for (; i < count; i++) {
+		const f32 dx    = x[i] - eye.x;
+		const f32 dy    = y[i] - eye.y;
+		const f32 depth = dx * forwards.x + dy * forwards.y;
+		const f32 side  = fabsf(dx * sidewards.x + dy * sidewards.y);
+		if (depth > 0 && side < depth * slope + margin)
+			indices[found++] = i;
+	}
+
+	return found;
+}
+
+// NOTE(bill): Moves points on the ground plane into the camera's space,
+// the same transform `render_sprite` uses. `out_x` is across the screen and
+// `out_z` is the depth; only depths above ~0 are in front of the camera.
+inline void
+batch_view_transform(const f32* x, const f32* y, int count,
+                     const Vector2& eye, f32 cos_yaw, f32 sin_yaw,
+                     f32* out_x, f32* out_z)
+{
+	int i = 0;
+#if MATH_BATCH_SSE
+	const __m128 ex = _mm_set1_ps(eye.x);
+	const __m128 ey = _mm_set1_ps(eye.y);
+	const __m128 c  = _mm_set1_ps(cos_yaw);
+	const __m128 s  = _mm_set1_ps(sin_yaw);
+	const __m128 p2 = _mm_set1_ps(+2.0f);
+	const __m128 m2 = _mm_set1_ps(-2.0f);
+	for (; i + 4 <= count; i += 4) {
+		const __m128 xc = _mm_mul_ps(p2, _mm_sub_ps(ex, _mm_loadu_ps(x + i)));
+		const __m128 yc = _mm_mul_ps(m2, _mm_sub_ps(ey, _mm_loadu_ps(y + i)));
+		_mm_storeu_ps(out_x + i, _mm_add_ps(_mm_mul_ps(xc, c), _mm_mul_ps(yc, s)));
+		_mm_storeu_ps(out_z + i, _mm_sub_ps(_mm_mul_ps(yc, c), _mm_mul_ps(xc, s)));
+	}
+#endif
+	for (; i < count; i++) {
+		const f32 xc = +2 * (eye.x - x[i]);
+		const f32 yc = -2 * (eye.y - y[i]);
+		out_x[i]     = xc * cos_yaw + yc * sin_yaw;
+		out_z[i]     = yc * cos_yaw - xc * sin_yaw;
+	}
+}
+
+#endif
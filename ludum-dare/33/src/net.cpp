@@ -0,0 +1,497 @@
+#include "net.hpp"
+
+internal s32
+quantize(f32 value, f32 scale)
+{
+	return (s32)floorf(value * scale + 0.5f);
+}
+
+internal f32
+dequantize(s32 value, f32 scale)
+{
+	return value / scale;
+}
+
+////////////////////////////////
+// Snapshots
+////////////////////////////////
+
+void
+destroy_snapshot(Net_Snapshot* snapshot)
+{
+	if (snapshot) {
+		free(snapshot->entities);
+		*snapshot = {};
+	}
+}
+
+internal void
+reserve_snapshot_entities(Net_Snapshot& snapshot, int count)
+{
+	if (count <= snapshot.entity_capacity)
+		return;
+
+	int capacity = 2 * snapshot.entity_capacity;
+	if (capacity < count)
+		capacity = count;
+
+	snapshot.entities        = (Net_Entity*)realloc(snapshot.entities, capacity * sizeof(Net_Entity));
+	snapshot.entity_capacity = capacity;
+}
+
+void
+capture_snapshot(const Game& game, u32 tick, Net_Snapshot* snapshot)
+{
+	const Player& player = game.player;
+	const Level& level   = *game.curr_level;
+
+	snapshot->tick = tick;
+
+	snapshot->player.x      = quantize(player.position.x, NET_POSITION_SCALE);
+	snapshot->player.y      = quantize(player.position.y, NET_POSITION_SCALE);
+	snapshot->player.z      = quantize(player.position.z, NET_POSITION_SCALE);
+	snapshot->player.yaw    = quantize(player.yaw, NET_ANGLE_SCALE);
+	snapshot->player.health = quantize(player.health, NET_STAT_SCALE);
+	snapshot->player.mana   = quantize(player.mana, NET_STAT_SCALE);
+
+	reserve_snapshot_entities(*snapshot, level.entity_count);
+	snapshot->entity_count = level.entity_count;
+	for (int i = 0; i < level.entity_count; i++) {
+		const Entity_Hot& e = level.entity_hot[i];
+		Net_Entity& n       = snapshot->entities[i];
+
+		n.type   = e.type;
+		n.x      = quantize(e.position.x, NET_POSITION_SCALE);
+		n.y      = quantize(e.position.y, NET_POSITION_SCALE);
+		n.z      = quantize(e.position.z, NET_POSITION_SCALE);
+		n.health = quantize(level.entity_cold[i].health, NET_STAT_SCALE);
+	}
+
+	snapshot->particle_first = game.particle_first;
+	snapshot->particle_count = game.particle_count;
+	for (int i = 0; i < game.particle_count; i++) {
+		const Particle& p = get_particle(game, i);
+		Net_Particle& n   = snapshot->particles[i];
+
+		n.x    = quantize(p.position.x, NET_POSITION_SCALE);
+		n.y    = quantize(p.position.y, NET_POSITION_SCALE);
+		n.z    = quantize(p.position.z, NET_POSITION_SCALE);
+		n.tex  = p.tex;
+		n.size = quantize(p.scale.x, NET_SIZE_SCALE);
+	}
+}
+
+// NOTE(bill): Index in `base` of the particle at `index` in `snapshot`, or -1.
+// Particles are in spawn order, so the same particle is `particle_first` apart.
+internal int
+get_base_particle(const Net_Snapshot& snapshot, const Net_Snapshot* base, int index)
+{
+	if (base == nullptr)
+		return -1;
+
+	const u32 base_index = snapshot.particle_first - base->particle_first + (u32)index;
+	return base_index < (u32)base->particle_count ? (int)base_index : -1;
+}
+
+// NOTE(bill): One change mask byte, then a zigzag varint per changed field
+template <typename T>
+internal void
+encode_fields(Byte_Buffer& out, const T& value, const T& base)
+{
+	constexpr int FIELD_COUNT = sizeof(T) / sizeof(s32);
+	static_assert(FIELD_COUNT <= 8, "Change mask is a single byte");
+
+	const s32* v = (const s32*)&value;
+	const s32* b = (const s32*)&base;
+
+	u8 mask = 0;
+	for (int i = 0; i < FIELD_COUNT; i++) {
+		if (v[i] != b[i])
+			mask |= 1 << i;
+	}
+
+	write_u8(out, mask);
+	for (int i = 0; i < FIELD_COUNT; i++) {
+		if (mask & (1 << i))
+			write_zigzag(out, (s32)((u32)v[i] - (u32)b[i]));
+	}
+}
+
+template <typename T>
+internal b32
+decode_fields(Byte_Buffer& in, T* value, const T& base)
+{
+	constexpr int FIELD_COUNT = sizeof(T) / sizeof(s32);
+
+	s32* v       = (s32*)value;
+	const s32* b = (const s32*)&base;
+
+	u8 mask = 0;
+	if (!read_u8(in, &mask))
+		return false;
+
+	for (int i = 0; i < FIELD_COUNT; i++) {
+		v[i] = b[i];
+		if (mask & (1 << i)) {
+			s32 delta = 0;
+			if (!read_zigzag(in, &delta))
+				return false;
+			v[i] = (s32)((u32)b[i] + (u32)delta);
+		}
+	}
+
+	return true;
+}
+
+void
+encode_snapshot(const Net_Snapshot& snapshot, const Net_Snapshot* baseline, Byte_Buffer& out)
+{
+	const Net_Entity zero_entity     = {};
+	const Net_Particle zero_particle = {};
+	const Net_Player zero_player     = {};
+
+	write_varint(out, snapshot.tick);
+	write_varint(out, baseline ? baseline->tick : 0);
+
+	encode_fields(out, snapshot.player, baseline ? baseline->player : zero_player);
+
+	write_varint(out, snapshot.entity_count);
+	for (int i = 0; i < snapshot.entity_count; i++) {
+		const b32 has_base = baseline && i < baseline->entity_count;
+		encode_fields(out, snapshot.entities[i], has_base ? baseline->entities[i] : zero_entity);
+	}
+
+	write_varint(out, snapshot.particle_first);
+	write_varint(out, snapshot.particle_count);
+	for (int i = 0; i < snapshot.particle_count; i++) {
+		const int base = get_base_particle(snapshot, baseline, i);
+		encode_fields(out, snapshot.particles[i], base >= 0 ? baseline->particles[base] : zero_particle);
+	}
+}
+
+// NOTE(bill): Decodes into `history[tick % NET_SNAPSHOT_HISTORY]` and returns
+// the tick, or 0 if the packet is malformed or its baseline is gone
+u32
+decode_snapshot(Byte_Buffer& in, Net_Snapshot* history)
+{
+	const Net_Entity zero_entity     = {};
+	const Net_Particle zero_particle = {};
+	const Net_Player zero_player     = {};
+
+	u32 tick          = 0;
+	u32 baseline_tick = 0;
+	if (!read_varint(in, &tick) || !read_varint(in, &baseline_tick))
+		return 0;
+	if (tick == 0 || tick <= baseline_tick)
+		return 0;
+	if (baseline_tick != 0 && tick - baseline_tick >= NET_SNAPSHOT_HISTORY)
+		return 0; // NOTE(bill): Would decode over its own baseline
+
+	const Net_Snapshot* baseline = nullptr;
+	if (baseline_tick != 0) {
+		baseline = &history[baseline_tick & (NET_SNAPSHOT_HISTORY - 1)];
+		if (baseline->tick != baseline_tick)
+			return 0;
+	}
+
+	Net_Snapshot& snapshot = history[tick & (NET_SNAPSHOT_HISTORY - 1)];
+	snapshot.tick          = 0; // NOTE(bill): Invalid until fully decoded
+
+	if (!decode_fields(in, &snapshot.player, baseline ? baseline->player : zero_player))
+		return 0;
+
+	u32 entity_count = 0;
+	if (!read_varint(in, &entity_count) || entity_count > (u32)(in.size - in.cursor))
+		return 0;
+	reserve_snapshot_entities(snapshot, entity_count);
+	snapshot.entity_count = entity_count;
+	for (int i = 0; i < snapshot.entity_count; i++) {
+		const b32 has_base = baseline && i < baseline->entity_count;
+		if (!decode_fields(in, &snapshot.entities[i], has_base ? baseline->entities[i] : zero_entity))
+			return 0;
+	}
+
+	u32 particle_count = 0;
+	if (!read_varint(in, &snapshot.particle_first) ||
+	    !read_varint(in, &particle_count) || particle_count > MAX_PARTICLES)
+		return 0;
+	snapshot.particle_count = particle_count;
+	for (int i = 0; i < snapshot.particle_count; i++) {
+		const int base = get_base_particle(snapshot, baseline, i);
+		if (!decode_fields(in, &snapshot.particles[i], base >= 0 ? baseline->particles[base] : zero_particle))
+			return 0;
+	}
+
+	snapshot.tick = tick;
+	return tick;
+}
+
+////////////////////////////////
+// Loopback Channel
+////////////////////////////////
+
+void
+send_packet(Loopback_Channel& channel, const Byte_Buffer& buffer, u32 tick)
+{
+	channel.sent_count++;
+	channel.bytes_sent += buffer.size;
+
+	if (channel.drop_interval > 0 && (channel.sent_count % channel.drop_interval) == 0)
+		return;
+
+	if (channel.packet_count == channel.packet_capacity) {
+		const int capacity      = channel.packet_capacity ? 2 * channel.packet_capacity : 8;
+		channel.packets         = (Net_Packet*)realloc(channel.packets, capacity * sizeof(Net_Packet));
+		channel.packet_capacity = capacity;
+		memset(channel.packets + channel.packet_count, 0,
+		       (capacity - channel.packet_count) * sizeof(Net_Packet));
+	}
+
+	Net_Packet& packet  = channel.packets[channel.packet_count++];
+	packet.deliver_tick = tick + channel.latency;
+	clear_byte_buffer(packet.buffer);
+	write_bytes(packet.buffer, buffer.data, buffer.size);
+}
+
+b32
+receive_packet(Loopback_Channel& channel, u32 tick, Byte_Buffer& out)
+{
+	if (channel.packet_count == 0 || channel.packets[0].deliver_tick > tick)
+		return false;
+
+	// NOTE(bill): Swap buffers so neither side reallocates in the steady state
+	Byte_Buffer received = channel.packets[0].buffer;
+	channel.packets[0].buffer = out;
+
+	const Net_Packet front = channel.packets[0];
+	memmove(channel.packets, channel.packets + 1, (channel.packet_count - 1) * sizeof(Net_Packet));
+	channel.packet_count--;
+	channel.packets[channel.packet_count] = front;
+
+	out        = received;
+	out.cursor = 0;
+	return true;
+}
+
+void
+destroy_channel(Loopback_Channel* channel)
+{
+	if (channel) {
+		for (int i = 0; i < channel->packet_capacity; i++)
+			destroy_byte_buffer(&channel->packets[i].buffer);
+		free(channel->packets);
+		*channel = {};
+	}
+}
+
+////////////////////////////////
+// Server
+////////////////////////////////
+
+Server_Client*
+connect_client(Server& server, int latency, int drop_interval)
+{
+	if (server.client_count == NET_MAX_CLIENTS)
+		return nullptr;
+
+	Server_Client& c = server.clients[server.client_count++];
+	c                = {};
+	c.acked_tick     = NET_NO_BASELINE;
+
+	c.to_client.latency       = latency;
+	c.to_client.drop_interval = drop_interval;
+	c.to_server.latency       = latency;
+	c.to_server.drop_interval = drop_interval;
+
+	return &c;
+}
+
+void
+update_server(Server& server, f32 dt)
+{
+	Byte_Buffer& ack = server.packets[0];
+
+	for (int i = 0; i < server.client_count; i++) {
+		Server_Client& c = server.clients[i];
+		while (receive_packet(c.to_server, server.tick, ack)) {
+			u32 tick = 0;
+			if (!read_varint(ack, &tick) || tick > server.tick)
+				continue;
+			if (c.acked_tick == NET_NO_BASELINE || tick > c.acked_tick)
+				c.acked_tick = tick;
+		}
+	}
+
+	update_game(*server.game, dt);
+	server.tick++;
+
+	const int send_interval = server.send_interval > 0 ? server.send_interval : 1;
+	if ((server.tick % send_interval) != 0)
+		return;
+
+	const f64 start_time = emscripten_get_now();
+	defer(server.net_time += emscripten_get_now() - start_time);
+
+	Net_Snapshot& snapshot = server.history[server.tick & (NET_SNAPSHOT_HISTORY - 1)];
+	capture_snapshot(*server.game, server.tick, &snapshot);
+
+	// NOTE(bill): Clients that acknowledged the same snapshot share one packet
+	u32 packet_baselines[NET_MAX_CLIENTS];
+	int packet_count = 0;
+
+	for (int i = 0; i < server.client_count; i++) {
+		Server_Client& c = server.clients[i];
+
+		const Net_Snapshot* baseline = nullptr;
+		u32 baseline_tick            = 0;
+		if (c.acked_tick != NET_NO_BASELINE &&
+		    server.tick - c.acked_tick < NET_SNAPSHOT_HISTORY) {
+			baseline = &server.history[c.acked_tick & (NET_SNAPSHOT_HISTORY - 1)];
+			if (baseline->tick == c.acked_tick)
+				baseline_tick = c.acked_tick;
+			else
+				baseline = nullptr;
+		}
+
+		int packet_index = 0;
+		while (packet_index < packet_count && packet_baselines[packet_index] != baseline_tick)
+			packet_index++;
+
+		Byte_Buffer& packet = server.packets[packet_index];
+		if (packet_index == packet_count) {
+			packet_baselines[packet_count++] = baseline_tick;
+			clear_byte_buffer(packet);
+			encode_snapshot(snapshot, baseline, packet);
+			server.encoded_bytes += packet.size;
+		}
+
+		send_packet(c.to_client, packet, server.tick);
+	}
+}
+
+void
+destroy_server(Server* server)
+{
+	if (server) {
+		for (int i = 0; i < NET_SNAPSHOT_HISTORY; i++)
+			destroy_snapshot(&server->history[i]);
+		for (int i = 0; i < NET_MAX_CLIENTS; i++) {
+			destroy_channel(&server->clients[i].to_client);
+			destroy_channel(&server->clients[i].to_server);
+			destroy_byte_buffer(&server->packets[i]);
+		}
+		*server = {};
+	}
+}
+
+////////////////////////////////
+// Client
+////////////////////////////////
+
+void
+update_client(Client& client)
+{
+	Server_Client& connection = *client.connection;
+
+	client.tick++;
+
+	u32 newest = 0;
+	while (receive_packet(connection.to_client, client.tick, client.packet)) {
+		const u32 tick = decode_snapshot(client.packet, client.history);
+		if (tick > client.latest_tick)
+			client.latest_tick = newest = tick;
+	}
+
+	if (newest != 0) {
+		clear_byte_buffer(client.packet);
+		write_varint(client.packet, newest);
+		send_packet(connection.to_server, client.packet, client.tick);
+	}
+}
+
+// NOTE(bill): Fills `view` with the world at `render_tick`, which should lag
+// behind `latest_tick` by a couple of snapshots so there is something to blend towards
+void
+interpolate_client(const Client& client, f32 render_tick, Game& view)
+{
+	const Net_Snapshot* a = nullptr;
+	const Net_Snapshot* b = nullptr;
+	for (int i = 0; i < NET_SNAPSHOT_HISTORY; i++) {
+		const Net_Snapshot* s = &client.history[i];
+		if (s->tick == 0 || s->tick + NET_SNAPSHOT_HISTORY <= client.latest_tick)
+			continue;
+
+		if (s->tick <= render_tick) {
+			if (a == nullptr || s->tick > a->tick)
+				a = s;
+		} else {
+			if (b == nullptr || s->tick < b->tick)
+				b = s;
+		}
+	}
+
+	if (a == nullptr)
+		a = b;
+	if (b == nullptr)
+		b = a;
+	if (a == nullptr)
+		return;
+
+	const f32 t = b->tick > a->tick ? (render_tick - a->tick) / (f32)(b->tick - a->tick) : 0.0f;
+
+	auto blend = [t](s32 x, s32 y, f32 scale) -> f32 {
+		return lerp(dequantize(x, scale), dequantize(y, scale), t);
+	};
+
+	view.player.position = {blend(a->player.x, b->player.x, NET_POSITION_SCALE),
+	                        blend(a->player.y, b->player.y, NET_POSITION_SCALE),
+	                        blend(a->player.z, b->player.z, NET_POSITION_SCALE)};
+	view.player.yaw    = blend(a->player.yaw, b->player.yaw, NET_ANGLE_SCALE);
+	view.player.health = dequantize(b->player.health, NET_STAT_SCALE);
+	view.player.mana   = dequantize(b->player.mana, NET_STAT_SCALE);
+
+	Level& level       = *view.curr_level;
+	level.entity_count = 0;
+	for (int i = 0; i < b->entity_count; i++) {
+		const Net_Entity& nb = b->entities[i];
+		// NOTE(bill): Slots get reused by swap-remove so only blend matching types
+		const Net_Entity& na = (i < a->entity_count && a->entities[i].type == nb.type) ? a->entities[i] : nb;
+
+		Entity e   = {};
+		e.type     = (Entity_Type)nb.type;
+		e.position = {blend(na.x, nb.x, NET_POSITION_SCALE),
+		              blend(na.y, nb.y, NET_POSITION_SCALE),
+		              blend(na.z, nb.z, NET_POSITION_SCALE)};
+		e.health = dequantize(nb.health, NET_STAT_SCALE);
+		add_entity(level, e);
+	}
+
+	view.particle_first = b->particle_first;
+	view.particle_count = b->particle_count;
+	for (int i = 0; i < b->particle_count; i++) {
+		const Net_Particle& nb = b->particles[i];
+		const int index        = get_base_particle(*b, a, i);
+		const Net_Particle& na = index >= 0 ? a->particles[index] : nb;
+
+		Particle& p = get_particle(view, i);
+		p           = {};
+		p.position  = {blend(na.x, nb.x, NET_POSITION_SCALE),
+		               blend(na.y, nb.y, NET_POSITION_SCALE),
+		               blend(na.z, nb.z, NET_POSITION_SCALE)};
+		const f32 size = dequantize(nb.size, NET_SIZE_SCALE);
+		p.scale        = {size, size};
+		p.tex          = nb.tex;
+		p.expires = start_cooldown(view.tick, 1.0f); // NOTE(bill): Retiring is up to the server
+	}
+}
+
+void
+destroy_client(Client* client)
+{
+	if (client) {
+		for (int i = 0; i < NET_SNAPSHOT_HISTORY; i++)
+			destroy_snapshot(&client->history[i]);
+		destroy_byte_buffer(&client->packet);
+		*client = {};
+	}
+}
@@ -0,0 +1,146 @@
+#ifndef NET_HPP
+#define NET_HPP
+
+#include "game.hpp"
+#include "byte_buffer.hpp"
+
+// NOTE(bill): Authoritative server with observing clients
+// The server runs `update_game` and streams quantised snapshots of the player,
+// `Level::entities` and the particles. Every field is delta compressed against
+// the last snapshot that client acknowledged.
+
+constexpr int NET_MAX_CLIENTS      = 16;
+constexpr int NET_SNAPSHOT_HISTORY = 32; // NOTE(bill): Must be a power of two
+constexpr u32 NET_NO_BASELINE      = 0xffffffff;
+
+// NOTE(bill): Quantisation steps
+constexpr f32 NET_POSITION_SCALE = 256.0f;        // 1/256th of a tile
+constexpr f32 NET_STAT_SCALE     = 16.0f;         // health and mana
+constexpr f32 NET_ANGLE_SCALE    = 4096.0f / TAU; // 4096 steps per turn
+constexpr f32 NET_SIZE_SCALE     = 64.0f;         // 1/64th of a tile, exact for `spawn_particles` sizes
+
+// NOTE(bill): All `Net_*` records are plain s32 fields so they can be
+// delta encoded field by field
+struct Net_Player {
+	s32 x, y, z;
+	s32 yaw;
+	s32 health;
+	s32 mana;
+};
+
+struct Net_Entity {
+	s32 type;
+	s32 x, y, z;
+	s32 health;
+};
+
+struct Net_Particle {
+	s32 x, y, z;
+	s32 tex;
+	s32 size; // NOTE(bill): `Particle::scale`, which is square
+};
+
+struct Net_Snapshot {
+	u32 tick; // NOTE(bill): 0 is never sent, it means empty
+
+	Net_Player player;
+
+	int entity_count;
+	int entity_capacity;
+	Net_Entity* entities;
+
+	u32 particle_first; // NOTE(bill): `Game::particle_first`, lines particles up with the baseline
+	int particle_count;
+	Net_Particle particles[MAX_PARTICLES];
+};
+
+// NOTE(bill): In-process stand-in for a socket. Packets arrive `latency` ticks
+// after they were sent and every `drop_interval`th packet is lost (0 is lossless)
+struct Net_Packet {
+	Byte_Buffer buffer;
+	u32 deliver_tick;
+};
+
+struct Loopback_Channel {
+	int latency;
+	int drop_interval;
+	u32 sent_count;
+	u64 bytes_sent;
+
+	int packet_count;
+	int packet_capacity;
+	Net_Packet* packets;
+};
+
+struct Server_Client {
+	Loopback_Channel to_client;
+	Loopback_Channel to_server;
+
+	u32 acked_tick;
+};
+
+struct Server {
+	Game* game;
+	u32 tick;
+	int send_interval; // NOTE(bill): Send a snapshot every n ticks
+
+	Net_Snapshot history[NET_SNAPSHOT_HISTORY];
+
+	int client_count;
+	Server_Client clients[NET_MAX_CLIENTS];
+
+	Byte_Buffer packets[NET_MAX_CLIENTS]; // NOTE(bill): Reused every send
+	u64 encoded_bytes;                    // Bytes actually encoded (shared packets count once)
+	f64 net_time;                         // Milliseconds spent capturing and encoding
+};
+
+struct Client {
+	Server_Client* connection;
+	u32 tick; // NOTE(bill): Local clock, in server ticks
+
+	u32 latest_tick; // NOTE(bill): 0 until the first snapshot arrives
+	Net_Snapshot history[NET_SNAPSHOT_HISTORY];
+
+	Byte_Buffer packet;
+};
+
+void
+destroy_snapshot(Net_Snapshot* snapshot);
+
+void
+capture_snapshot(const Game& game, u32 tick, Net_Snapshot* snapshot);
+
+void
+encode_snapshot(const Net_Snapshot& snapshot, const Net_Snapshot* baseline, Byte_Buffer& out);
+
+u32
+decode_snapshot(Byte_Buffer& in, Net_Snapshot* history);
+
+void
+send_packet(Loopback_Channel& channel, const Byte_Buffer& buffer, u32 tick);
+
+b32
+receive_packet(Loopback_Channel& channel, u32 tick, Byte_Buffer& out);
+
+void
+destroy_channel(Loopback_Channel* channel);
+
+Server_Client*
+connect_client(Server& server, int latency, int drop_interval);
+
+void
+update_server(Server& server, f32 dt);
+
+void
+destroy_server(Server* server);
+
+void
+update_client(Client& client);
+
+void
+interpolate_client(const Client& client, f32 render_tick, Game& view);
+
+void
+destroy_client(Client* client);
+
+#endif
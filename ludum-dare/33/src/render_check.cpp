@@ -0,0 +1,368 @@
+// Render Check
+//
+// Headless unity build: renders a fixed set of camera poses on level001.png
+// through `RENDER_PROCS_REFERENCE` and through each optimised kernel of
+// `RENDER_PROCS` on its own, then all of them together. Every frame's pixels
+// and depth buffer are diffed against the reference frame. Each path that
+// differs gets a heatmap of where, printed and written to
+// render_check_<path>.ppm. Both paths are timed in the same run.
+//
+// Usage: render_check [repeats] [tolerance] [depth_tolerance]
+//
+// `tolerance` is per colour channel, `depth_tolerance` is relative. Both
+// default to 0, i.e. bit for bit.
+
+#include "bitmap.cpp"
+#include "level.cpp"
+#include "level_manager.cpp"
+#include "game.cpp"
+
+constexpr int POSE_COUNT   = 32;
+constexpr int SETTLE_TICKS = 45; // NOTE(bill): Enough for the emitters to fill in
+constexpr f32 FOG_STRENGTH = 0.3f;
+
+constexpr int HEATMAP_CELL_WIDTH  = 4;
+constexpr int HEATMAP_CELL_HEIGHT = 6;
+
+enum Render_Kernel {
+	RENDER_KERNEL_FLOORS,
+	RENDER_KERNEL_WALLS,
+	RENDER_KERNEL_ENTITIES,
+	RENDER_KERNEL_PARTICLES,
+	RENDER_KERNEL_POST_FX,
+
+	RENDER_KERNEL_COUNT,
+	RENDER_KERNEL_ALL = RENDER_KERNEL_COUNT,
+};
+
+// NOTE(bill): Indexed by `Render_Kernel`
+global const char* RENDER_KERNEL_NAMES[] = {
+    "floors",
+    "walls",
+    "entities",
+    "particles",
+    "post_fx",
+    "all",
+};
+
+struct Render_Path {
+	Render_Procs procs;
+	b32 optimised; // NOTE(bill): False when it is just the reference again
+
+	u32 pixel_mismatches;
+	u32 depth_mismatches;
+	int max_channel_error;
+	f32 max_depth_error;
+	u32* heatmap; // NOTE(bill): Poses mismatched, per pixel
+
+	f64 time;
+};
+
+struct Pose {
+	Vector2 position;
+	f32 yaw;
+};
+
+// NOTE(bill): Reference procs with the optimised version of one kernel
+internal Render_Path
+make_render_path(int kernel)
+{
+	Render_Path path = {};
+	path.procs       = RENDER_PROCS_REFERENCE;
+
+	const Render_Procs& optimised = RENDER_PROCS;
+	switch (kernel) {
+	case RENDER_KERNEL_FLOORS:
+		path.procs.render_floors = optimised.render_floors;
+		break;
+	case RENDER_KERNEL_WALLS:
+		path.procs.render_walls = optimised.render_walls;
+		break;
+	case RENDER_KERNEL_ENTITIES:
+		path.procs.render_entities = optimised.render_entities;
+		break;
+	case RENDER_KERNEL_PARTICLES:
+		path.procs.render_particles = optimised.render_particles;
+		break;
+	case RENDER_KERNEL_POST_FX:
+		path.procs.apply_post_fx = optimised.apply_post_fx;
+		break;
+	default:
+		path.procs = optimised;
+		break;
+	}
+
+	path.optimised = memcmp(&path.procs, &RENDER_PROCS_REFERENCE, sizeof(Render_Procs)) != 0;
+	return path;
+}
+
+// NOTE(bill): Same as `create_framebuffer` without an SDL surface
+internal Framebuffer
+create_headless_framebuffer(int width, int height)
+{
+	Framebuffer fb  = {};
+	fb.width        = width;
+	fb.height       = height;
+	fb.pitch        = width * 4;
+	fb.pixels       = (Color*)calloc(width * height, sizeof(Color));
+	fb.depth_buffer = (f32*)calloc(width * height, sizeof(f32));
+	return fb;
+}
+
+internal void
+destroy_headless_framebuffer(Framebuffer* fb)
+{
+	if (fb) {
+		free(fb->pixels);
+		free(fb->depth_buffer);
+		*fb = {};
+	}
+}
+
+// NOTE(bill): Random floor tiles and yaws from a fixed seed, the first is the
+// spawn point looking the way a new game does
+internal void
+make_poses(const Level& level, Pose* poses, int count)
+{
+	Random_Series rng = random_series(0x1d33, RANDOM_STREAM_BOT);
+
+	poses[0].position = {level.init_position.x, level.init_position.y};
+	poses[0].yaw      = -TAU / 4;
+
+	for (int i = 1; i < count;) {
+		const int x = random_u32(rng) % level.width;
+		const int y = random_u32(rng) % level.height;
+		if (get_tile(level, x, y).type != TILE_FLOOR)
+			continue;
+
+		poses[i].position = {x, y};
+		poses[i].yaw      = TAU * random_unit(rng);
+		i++;
+	}
+}
+
+// NOTE(bill): Fresh copy of the level with the player stood at the pose for
+// `SETTLE_TICKS`, so the mobs and particles are wherever they get to
+internal Camera
+start_pose(Game& game, const Level& level, const Pose& pose)
+{
+	destroy_level_instance(&game.level001);
+	game.level001       = instance_level(level);
+	game.curr_level     = &game.level001;
+	game.particle_count = 0;
+	game.has_finished   = false;
+	seed_game_random(game, 0x1d33);
+
+	reset_player(game);
+	game.player.max_health = game.player.health = 1e9f;
+	game.player.x   = pose.position.x;
+	game.player.y   = pose.position.y;
+	game.player.yaw = pose.yaw;
+
+	for (int tick = 0; tick < SETTLE_TICKS; tick++)
+		update_game(game, TIME_STEP);
+
+	return make_camera(game.player, SCREEN_WIDTH, SCREEN_HEIGHT);
+}
+
+// NOTE(bill): Renders `repeats` times and returns the total time
+internal f64
+render_path(Game& game, const Camera& camera, const Render_Procs& procs, Framebuffer& target, int repeats)
+{
+	game.display      = target;
+	game.render_procs = &procs;
+	defer({
+		game.display      = {};
+		game.render_procs = nullptr;
+	});
+
+	const f64 start_time = emscripten_get_now();
+	for (int i = 0; i < repeats; i++) {
+		clear_buffers(target, BLACK);
+		render_level(game, camera, FOG_STRENGTH);
+	}
+	return emscripten_get_now() - start_time;
+}
+
+internal void
+diff_frames(const Framebuffer& reference, const Framebuffer& frame,
+            int tolerance, f32 depth_tolerance, Render_Path& path)
+{
+	for (int i = 0; i < reference.width * reference.height; i++) {
+		const Color a = reference.pixels[i];
+		const Color b = frame.pixels[i];
+
+		int error = 0;
+		error     = max(error, abs((int)a.r - (int)b.r));
+		error     = max(error, abs((int)a.g - (int)b.g));
+		error     = max(error, abs((int)a.b - (int)b.b));
+		error     = max(error, abs((int)a.a - (int)b.a));
+
+		const f32 da = reference.depth_buffer[i];
+		const f32 db = frame.depth_buffer[i];
+
+		const f32 depth_error = abs(da - db);
+		const f32 depth_limit = depth_tolerance * max(abs(da), abs(db));
+
+		const b32 pixel_bad = error > tolerance;
+		const b32 depth_bad = depth_error > depth_limit;
+
+		path.pixel_mismatches += pixel_bad;
+		path.depth_mismatches += depth_bad;
+		path.max_channel_error = max(path.max_channel_error, error);
+		path.max_depth_error   = max(path.max_depth_error, depth_error);
+		if (pixel_bad || depth_bad)
+			path.heatmap[i]++;
+	}
+}
+
+internal void
+print_heatmap(const u32* heatmap, int width, int height)
+{
+	local_persist const char RAMP[] = " .:-=+*#%@";
+	constexpr int RAMP_LAST        = sizeof(RAMP) - 2;
+
+	for (int cy = 0; cy < height; cy += HEATMAP_CELL_HEIGHT) {
+		char line[SCREEN_WIDTH / HEATMAP_CELL_WIDTH + 3];
+		int length     = 0;
+		line[length++] = '|';
+		for (int cx = 0; cx < width; cx += HEATMAP_CELL_WIDTH) {
+			u32 hits = 0;
+			u32 area = 0;
+			for (int y = cy; y < cy + HEATMAP_CELL_HEIGHT && y < height; y++) {
+				for (int x = cx; x < cx + HEATMAP_CELL_WIDTH && x < width; x++) {
+					hits += heatmap[x + y * width];
+					area += POSE_COUNT;
+				}
+			}
+			// NOTE(bill): Any mismatch at all shows, however few
+			const int level = hits == 0 ? 0 : 1 + (int)((RAMP_LAST - 1) * (u64)hits / area);
+			line[length++]  = RAMP[level];
+		}
+		line[length++] = '|';
+		line[length]   = '\0';
+		printf("  %s\n", line);
+	}
+}
+
+// NOTE(bill): Black where it always matched, through red to yellow where it
+// never did
+internal b32
+write_heatmap(const char* filename, const u32* heatmap, int width, int height)
+{
+	FILE* file = fopen(filename, "wb");
+	if (file == nullptr)
+		return false;
+	defer(fclose(file));
+
+	fprintf(file, "P6\n%d %d\n255\n", width, height);
+	for (int i = 0; i < width * height; i++) {
+		const f32 t = (f32)heatmap[i] / POSE_COUNT;
+
+		u8 rgb[3];
+		rgb[0] = heatmap[i] == 0 ? 0 : (u8)(127 + 128 * clamp(2 * t, 0, 1));
+		rgb[1] = (u8)(255 * clamp(2 * t - 1, 0, 1));
+		rgb[2] = 0;
+		fwrite(rgb, 1, 3, file);
+	}
+	return true;
+}
+
+int
+main(int argc, char** argv)
+{
+	const int repeats         = argc > 1 ? max(atoi(argv[1]), 1) : 8;
+	const int tolerance       = argc > 2 ? atoi(argv[2]) : 0;
+	const f32 depth_tolerance = argc > 3 ? (f32)atof(argv[3]) : 0.0f;
+
+	art::floors    = load_bitmap_from_file("floors.png");
+	art::sprites   = load_bitmap_from_file("sprites.png");
+	art::particles = load_bitmap_from_file("particles.png");
+	if (!art::floors.pixels || !art::sprites.pixels || !art::particles.pixels)
+		return 1;
+	defer({
+		destroy_bitmap(&art::floors);
+		destroy_bitmap(&art::sprites);
+		destroy_bitmap(&art::particles);
+	});
+
+	Level level = load_level_from_file("level001.png");
+	if (level.grid == nullptr)
+		return 1;
+	defer(destroy_level(&level));
+
+	local_persist u8 keys[MAX_KEYS] = {}; // NOTE(bill): Nothing is ever pressed
+	local_persist Pose poses[POSE_COUNT];
+	make_poses(level, poses, POSE_COUNT);
+
+	Game* game = (Game*)calloc(1, sizeof(Game));
+	defer({
+		destroy_level_instance(&game->level001);
+		free(game);
+	});
+	game->keys     = keys;
+	game->headless = true;
+
+	Framebuffer golden = create_headless_framebuffer(SCREEN_WIDTH, SCREEN_HEIGHT);
+	Framebuffer frame  = create_headless_framebuffer(SCREEN_WIDTH, SCREEN_HEIGHT);
+	defer({
+		destroy_headless_framebuffer(&golden);
+		destroy_headless_framebuffer(&frame);
+	});
+
+	Render_Path paths[RENDER_KERNEL_COUNT + 1];
+	for (int i = 0; i <= RENDER_KERNEL_COUNT; i++) {
+		paths[i]         = make_render_path(i);
+		paths[i].heatmap = (u32*)calloc(SCREEN_WIDTH * SCREEN_HEIGHT, sizeof(u32));
+	}
+	defer({
+		for (Render_Path& path : paths)
+			free(path.heatmap);
+	});
+
+	f64 reference_time = 0;
+	for (const Pose& pose : poses) {
+		const Camera camera = start_pose(*game, level, pose);
+
+		reference_time += render_path(*game, camera, RENDER_PROCS_REFERENCE, golden, repeats);
+		for (Render_Path& path : paths) {
+			if (!path.optimised)
+				continue;
+			path.time += render_path(*game, camera, path.procs, frame, repeats);
+			diff_frames(golden, frame, tolerance, depth_tolerance, path);
+		}
+	}
+
+	const f64 per_frame = 1000.0 / (POSE_COUNT * repeats); // NOTE(bill): ms to us
+	printf("[Render] %d poses, %d repeats, %dx%d, tolerance %d, depth tolerance %g\n",
+	       POSE_COUNT, repeats, SCREEN_WIDTH, SCREEN_HEIGHT, tolerance, depth_tolerance);
+	printf("[Render] reference: %.2f us/frame\n", reference_time * per_frame);
+
+	int failures = 0;
+	for (int i = 0; i <= RENDER_KERNEL_COUNT; i++) {
+		Render_Path& path = paths[i];
+		const char* name  = RENDER_KERNEL_NAMES[i];
+		if (!path.optimised) {
+			printf("[Render] %-9s no optimised version\n", name);
+			continue;
+		}
+
+		printf("[Render] %-9s %.2f us/frame (%.2fx), %u pixels and %u depths mismatched, max error %d, max depth error %g\n",
+		       name, path.time * per_frame, reference_time / path.time,
+		       path.pixel_mismatches, path.depth_mismatches,
+		       path.max_channel_error, path.max_depth_error);
+
+		if (path.pixel_mismatches == 0 && path.depth_mismatches == 0)
+			continue;
+
+		failures++;
+		print_heatmap(path.heatmap, SCREEN_WIDTH, SCREEN_HEIGHT);
+
+		char filename[64];
+		snprintf(filename, sizeof(filename), "render_check_%s.ppm", name);
+		if (write_heatmap(filename, path.heatmap, SCREEN_WIDTH, SCREEN_HEIGHT))
+			printf("[Render] Wrote %s\n", filename);
+	}
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,263 @@
+#include "replay.hpp"
+
+internal u32
+get_key_mask(const u8* keys)
+{
+	u32 mask = 0;
+	for (int i = 0; i < REPLAY_KEY_COUNT; i++) {
+		if (keys[REPLAY_KEYS[i]])
+			mask |= 1 << i;
+	}
+	return mask;
+}
+
+internal void
+set_key_mask(u8* keys, u32 mask)
+{
+	for (int i = 0; i < REPLAY_KEY_COUNT; i++)
+		keys[REPLAY_KEYS[i]] = (mask >> i) & 1;
+}
+
+// NOTE(bill): Applies every change up to and including `tick`
+internal u32
+advance_cursor(const Replay& replay, Replay_Cursor& cursor, u32 tick)
+{
+	for (;;) {
+		if (!cursor.has_pending) {
+			if (cursor.offset >= replay.stream.size)
+				break;
+
+			Byte_Buffer in = replay.stream;
+			in.cursor      = cursor.offset;
+
+			u32 gap    = 0;
+			u32 change = 0;
+			if (!read_varint(in, &gap) || !read_varint(in, &change)) {
+				cursor.offset = replay.stream.size; // NOTE(bill): Truncated, ignore the rest
+				break;
+			}
+
+			cursor.offset         = in.cursor;
+			cursor.has_pending    = true;
+			cursor.pending_tick   = cursor.last_change_tick + gap;
+			cursor.pending_change = change;
+		}
+
+		if (cursor.pending_tick > tick)
+			break;
+
+		cursor.keys ^= cursor.pending_change;
+		cursor.last_change_tick = cursor.pending_tick;
+		cursor.has_pending      = false;
+	}
+
+	return cursor.keys;
+}
+
+internal void
+push_keyframe(Replay& replay, const Replay_Cursor& cursor, const Game& game)
+{
+	if (replay.keyframe_count == replay.keyframe_capacity) {
+		const int capacity = replay.keyframe_capacity ? 2 * replay.keyframe_capacity : 16;
+
+		replay.keyframes = (Replay_Keyframe*)realloc(replay.keyframes, capacity * sizeof(Replay_Keyframe));
+		memset(replay.keyframes + replay.keyframe_capacity, 0,
+		       (capacity - replay.keyframe_capacity) * sizeof(Replay_Keyframe));
+		replay.keyframe_capacity = capacity;
+	}
+
+	Replay_Keyframe& keyframe = replay.keyframes[replay.keyframe_count++];
+	keyframe.cursor           = cursor;
+	save_sim_state(game, &keyframe.state);
+}
+
+internal void
+clear_replay_keyframes(Replay& replay)
+{
+	// NOTE(bill): Keep the allocations, `save_sim_state` reuses them
+	replay.keyframe_count = 0;
+}
+
+void
+begin_replay(Replay& replay, Game& game, u32 seed, b32 record_keyframes)
+{
+	clear_byte_buffer(replay.stream);
+	clear_replay_keyframes(replay);
+
+	replay.seed             = seed;
+	replay.tick_count       = 0;
+	replay.keys             = 0;
+	replay.last_change_tick = 0;
+	replay.record_keyframes = record_keyframes;
+
+	seed_game_random(game, seed);
+}
+
+// NOTE(bill): Call with the keys for this tick, before `update_game`
+void
+record_replay_tick(Replay& replay, Game& game, const u8* keys)
+{
+	const u32 tick = replay.tick_count;
+
+	if (replay.record_keyframes && (tick % REPLAY_KEYFRAME_INTERVAL) == 0) {
+		Replay_Cursor cursor    = {};
+		cursor.offset           = replay.stream.size;
+		cursor.keys             = replay.keys;
+		cursor.last_change_tick = replay.last_change_tick;
+		push_keyframe(replay, cursor, game);
+	}
+
+	const u32 mask = get_key_mask(keys);
+	if (mask != replay.keys) {
+		write_varint(replay.stream, tick - replay.last_change_tick);
+		write_varint(replay.stream, mask ^ replay.keys);
+
+		replay.keys             = mask;
+		replay.last_change_tick = tick;
+	}
+
+	replay.tick_count++;
+}
+
+void
+destroy_replay(Replay* replay)
+{
+	if (replay) {
+		destroy_byte_buffer(&replay->stream);
+		for (int i = 0; i < replay->keyframe_capacity; i++)
+			destroy_sim_state(&replay->keyframes[i].state);
+		free(replay->keyframes);
+		*replay = {};
+	}
+}
+
+b32
+save_replay_to_file(const Replay& replay, const char* filename)
+{
+	FILE* file = fopen(filename, "wb");
+	if (file == nullptr) {
+		printf("Could not open \"%s\" for writing\n", filename);
+		return false;
+	}
+	defer(fclose(file));
+
+	const u32 header[] = {
+	    REPLAY_MAGIC,
+	    REPLAY_VERSION,
+	    replay.seed,
+	    replay.tick_count,
+	    (u32)replay.stream.size,
+	};
+
+	if (fwrite(header, sizeof(header), 1, file) != 1)
+		return false;
+	if (replay.stream.size > 0 && fwrite(replay.stream.data, replay.stream.size, 1, file) != 1)
+		return false;
+
+	return true;
+}
+
+b32
+load_replay_from_file(Replay* replay, const char* filename)
+{
+	FILE* file = fopen(filename, "rb");
+	if (file == nullptr) {
+		printf("Could not load \"%s\" from file\n", filename);
+		return false;
+	}
+	defer(fclose(file));
+
+	u32 header[5] = {};
+	if (fread(header, sizeof(header), 1, file) != 1 ||
+	    header[0] != REPLAY_MAGIC || header[1] != REPLAY_VERSION) {
+		printf("\"%s\" is not a replay\n", filename);
+		return false;
+	}
+
+	destroy_replay(replay);
+	replay->seed       = header[2];
+	replay->tick_count = header[3];
+
+	reserve_bytes(replay->stream, header[4]);
+	if (header[4] > 0 && fread(replay->stream.data, header[4], 1, file) != 1) {
+		destroy_replay(replay);
+		return false;
+	}
+	replay->stream.size = header[4];
+
+	return true;
+}
+
+// NOTE(bill): `game` must be in the state the recording started from;
+// simulates the whole replay once
+void
+build_replay_keyframes(Replay& replay, Game& game)
+{
+	clear_replay_keyframes(replay);
+	seed_game_random(game, replay.seed);
+
+	Replay_Player* player = (Replay_Player*)calloc(1, sizeof(Replay_Player));
+	defer(free(player));
+	player->replay = &replay;
+
+	while (player->tick < replay.tick_count) {
+		if ((player->tick % REPLAY_KEYFRAME_INTERVAL) == 0)
+			push_keyframe(replay, player->cursor, game);
+		step_replay(*player, game);
+	}
+}
+
+// NOTE(bill): Needs the keyframes, either recorded or built
+void
+begin_replay_playback(Replay_Player& player, const Replay& replay, Game& game)
+{
+	player.replay = &replay;
+	player.tick   = 0;
+	player.cursor = {};
+	memset(player.keys, 0, sizeof(player.keys));
+
+	if (replay.keyframe_count > 0) {
+		player.cursor = replay.keyframes[0].cursor;
+		load_sim_state(game, replay.keyframes[0].state);
+	}
+}
+
+b32
+step_replay(Replay_Player& player, Game& game)
+{
+	if (player.tick >= player.replay->tick_count)
+		return false;
+
+	set_key_mask(player.keys, advance_cursor(*player.replay, player.cursor, player.tick));
+	game.keys = player.keys;
+	update_game(game, TIME_STEP);
+
+	player.tick++;
+	return true;
+}
+
+// NOTE(bill): Restores the nearest keyframe at or before `tick` unless
+// simulating forwards from where we are is cheaper
+void
+seek_replay(Replay_Player& player, Game& game, u32 tick)
+{
+	const Replay& replay = *player.replay;
+	if (tick > replay.tick_count)
+		tick = replay.tick_count;
+
+	int index = tick / REPLAY_KEYFRAME_INTERVAL;
+	if (index >= replay.keyframe_count)
+		index = replay.keyframe_count - 1;
+
+	if (index >= 0) {
+		const u32 keyframe_tick = index * REPLAY_KEYFRAME_INTERVAL;
+		if (tick < player.tick || keyframe_tick > player.tick) {
+			player.cursor = replay.keyframes[index].cursor;
+			player.tick   = keyframe_tick;
+			load_sim_state(game, replay.keyframes[index].state);
+		}
+	}
+
+	while (player.tick < tick)
+		step_replay(player, game);
+}
@@ -0,0 +1,93 @@
+#ifndef REPLAY_HPP
+#define REPLAY_HPP
+
+#include "game.hpp"
+#include "byte_buffer.hpp"
+
+// NOTE(bill): A replay is the RNG seed plus the key state of every tick.
+// The key state is a bitmask over `REPLAY_KEYS` and only changes are stored,
+// as varint pairs of (ticks since the last change, old mask ^ new mask), so
+// held keys cost nothing. Keyframes of the full `Sim_State` are taken every
+// `REPLAY_KEYFRAME_INTERVAL` ticks so seeking never simulates more than one
+// interval. Keyframes live in memory only and are rebuilt after loading; a
+// recording that never seeks can skip them.
+
+constexpr u32 REPLAY_MAGIC             = 0x3333444c; // "LD33"
+constexpr u32 REPLAY_VERSION           = 4;
+constexpr u32 REPLAY_KEYFRAME_INTERVAL = 600; // 10 seconds
+
+constexpr int REPLAY_KEYS[] = {
+    SDLK_LEFT, SDLK_RIGHT, SDLK_UP, SDLK_DOWN,
+    SDLK_1, SDLK_2, SDLK_3, SDLK_4,
+    SDLK_SPACE,
+};
+constexpr int REPLAY_KEY_COUNT = sizeof(REPLAY_KEYS) / sizeof(REPLAY_KEYS[0]);
+
+// NOTE(bill): Read position in `Replay::stream`
+struct Replay_Cursor {
+	int offset;
+	u32 keys;
+	u32 last_change_tick;
+
+	b32 has_pending;
+	u32 pending_tick;
+	u32 pending_change;
+};
+
+struct Replay_Keyframe {
+	Replay_Cursor cursor; // NOTE(bill): As it was before the keyframe's tick
+	Sim_State state;
+};
+
+struct Replay {
+	u32 seed;
+	u32 tick_count;
+	Byte_Buffer stream;
+
+	// NOTE(bill): Recording state
+	u32 keys;
+	u32 last_change_tick;
+	b32 record_keyframes;
+
+	// NOTE(bill): keyframes[i] is taken before tick i * REPLAY_KEYFRAME_INTERVAL
+	int keyframe_count;
+	int keyframe_capacity;
+	Replay_Keyframe* keyframes;
+};
+
+struct Replay_Player {
+	const Replay* replay;
+	Replay_Cursor cursor;
+	u32 tick; // NOTE(bill): Next tick to simulate
+
+	u8 keys[MAX_KEYS];
+};
+
+void
+begin_replay(Replay& replay, Game& game, u32 seed, b32 record_keyframes = true);
+
+void
+record_replay_tick(Replay& replay, Game& game, const u8* keys);
+
+void
+destroy_replay(Replay* replay);
+
+b32
+save_replay_to_file(const Replay& replay, const char* filename);
+
+b32
+load_replay_from_file(Replay* replay, const char* filename);
+
+void
+build_replay_keyframes(Replay& replay, Game& game);
+
+void
+begin_replay_playback(Replay_Player& player, const Replay& replay, Game& game);
+
+b32
+step_replay(Replay_Player& player, Game& game);
+
+void
+seek_replay(Replay_Player& player, Game& game, u32 tick);
+
+#endif
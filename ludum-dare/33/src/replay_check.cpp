@@ -0,0 +1,103 @@
+// Replay Check
+//
+// Headless unity build: records a scripted session on level001.png, saves it,
+// loads it back, rebuilds the keyframes and seeks to random ticks in random
+// order. Each seek is checked against a hash of the state the recording had
+// at that tick. Reports the replay size and seek cost.
+//
+// Usage: replay_check [ticks] [seed]
+
+#include "bitmap.cpp"
+#include "level.cpp"
+#include "level_manager.cpp"
+#include "game.cpp"
+#include "replay.cpp"
+#include "headless_game.hpp"
+#include "sim_hash.hpp"
+
+constexpr int SAMPLE_COUNT = 64;
+
+int
+main(int argc, char** argv)
+{
+	const u32 ticks = argc > 1 ? (u32)atoi(argv[1]) : 60 * 60 * 10;
+	const u32 seed  = argc > 2 ? (u32)atoi(argv[2]) : 0x1d33;
+	const char* filename = "replay_check.replay";
+
+	Level level = load_level_from_file("level001.png");
+	if (level.grid == nullptr)
+		return 1;
+	defer(destroy_level(&level));
+
+	local_persist u8 keys[MAX_KEYS] = {};
+	local_persist Game game         = {};
+	start_headless_game(game, level, keys, seed);
+	defer(destroy_level_instance(&game.level001));
+
+	Random_Series bot = random_series(seed, RANDOM_STREAM_BOT);
+	u32 hold_ticks    = 0;
+
+	u32 sample_ticks[SAMPLE_COUNT];
+	u64 sample_hashes[SAMPLE_COUNT];
+	for (int i = 0; i < SAMPLE_COUNT; i++)
+		sample_ticks[i] = random_u32(bot) % (ticks + 1);
+
+	// NOTE(bill): Record
+	Replay replay = {};
+	defer(destroy_replay(&replay));
+	begin_replay(replay, game, seed, false); // NOTE(bill): As main.cpp records
+
+	for (u32 tick = 0; tick <= ticks; tick++) {
+		for (int i = 0; i < SAMPLE_COUNT; i++) {
+			if (sample_ticks[i] == tick)
+				sample_hashes[i] = get_sim_hash(hash_sim_state(game));
+		}
+		if (tick == ticks)
+			break;
+
+		script_keys(bot, keys, &hold_ticks);
+		record_replay_tick(replay, game, keys);
+		update_game(game, TIME_STEP);
+	}
+
+	if (!save_replay_to_file(replay, filename))
+		return 1;
+	defer(remove(filename));
+
+	// NOTE(bill): Play back from the file
+	destroy_replay(&replay);
+	if (!load_replay_from_file(&replay, filename))
+		return 1;
+	start_headless_game(game, level, keys, replay.seed);
+
+	const f64 build_start = emscripten_get_now();
+	build_replay_keyframes(replay, game);
+	const f64 build_time = emscripten_get_now() - build_start;
+
+	Replay_Player* player = (Replay_Player*)calloc(1, sizeof(Replay_Player));
+	defer(free(player));
+	begin_replay_playback(*player, replay, game);
+
+	int failures  = 0;
+	f64 seek_time = 0;
+	for (int i = 0; i < SAMPLE_COUNT; i++) {
+		const f64 start_time = emscripten_get_now();
+		seek_replay(*player, game, sample_ticks[i]);
+		seek_time += emscripten_get_now() - start_time;
+
+		if (get_sim_hash(hash_sim_state(game)) != sample_hashes[i]) {
+			printf("[Replay] Mismatch at tick %u\n", sample_ticks[i]);
+			failures++;
+		}
+	}
+
+	const f32 minutes = ticks * TIME_STEP / 60.0f;
+	printf("[Replay] %u ticks (%.1f minutes), seed 0x%x\n", ticks, minutes, seed);
+	printf("[Replay] Input stream: %d bytes (%.1f bytes/minute), %d keyframes in memory\n",
+	       replay.stream.size, replay.stream.size / minutes, replay.keyframe_count);
+	printf("[Replay] Keyframes rebuilt in %.2f ms, average seek %.3f ms\n",
+	       build_time, seek_time / SAMPLE_COUNT);
+	printf("[Replay] %d/%d seeks matched the recording\n", SAMPLE_COUNT - failures, SAMPLE_COUNT);
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,101 @@
+// Sim Check
+//
+// Headless unity build: plays one scripted session on level001.png twice side
+// by side, through `SIM_PROCS_REFERENCE` and through `SIM_PROCS`, and hashes
+// the whole simulation state of both after every tick. Reports the first tick
+// where they diverge and which part of the state differs, and the time each
+// spent in `update_game`.
+//
+// Usage: sim_check [ticks] [seed]
+
+#include "bitmap.cpp"
+#include "level.cpp"
+#include "level_manager.cpp"
+#include "game.cpp"
+#include "headless_game.hpp"
+#include "sim_hash.hpp"
+
+internal void
+print_mismatch(const char* part, u64 reference, u64 optimised)
+{
+	if (reference != optimised)
+		printf("[Sim] %-9s reference %016llx, optimised %016llx\n", part,
+		       (unsigned long long)reference, (unsigned long long)optimised);
+}
+
+int
+main(int argc, char** argv)
+{
+	const u32 ticks = argc > 1 ? (u32)atoi(argv[1]) : 60 * 60 * 10;
+	const u32 seed  = argc > 2 ? (u32)atoi(argv[2]) : 0x1d33;
+
+	Level level = load_level_from_file("level001.png");
+	if (level.grid == nullptr)
+		return 1;
+	defer(destroy_level(&level));
+
+	local_persist u8 keys[MAX_KEYS] = {};
+
+	Game* reference = (Game*)calloc(1, sizeof(Game));
+	Game* optimised = (Game*)calloc(1, sizeof(Game));
+	defer({
+		destroy_level_instance(&reference->level001);
+		destroy_level_instance(&optimised->level001);
+		free(reference);
+		free(optimised);
+	});
+	start_headless_game(*reference, level, keys, seed, &SIM_PROCS_REFERENCE);
+	start_headless_game(*optimised, level, keys, seed, &SIM_PROCS);
+
+	Random_Series bot = random_series(seed, RANDOM_STREAM_BOT);
+	u32 hold_ticks    = 0;
+
+	u64 reference_run = 0;
+	u64 optimised_run = 0;
+	f64 reference_time = 0;
+	f64 optimised_time = 0;
+	f64 hash_time      = 0;
+
+	u32 tick = 0;
+	for (; tick < ticks; tick++) {
+		script_keys(bot, keys, &hold_ticks);
+
+		// NOTE(bill): Both keep playing after the player would have won or died
+		reference->has_finished = false;
+		optimised->has_finished = false;
+
+		f64 start_time = emscripten_get_now();
+		update_game(*reference, TIME_STEP);
+		reference_time += emscripten_get_now() - start_time;
+
+		start_time = emscripten_get_now();
+		update_game(*optimised, TIME_STEP);
+		optimised_time += emscripten_get_now() - start_time;
+
+		start_time      = emscripten_get_now();
+		const Sim_Hash a = hash_sim_state(*reference);
+		const Sim_Hash b = hash_sim_state(*optimised);
+		hash_time += emscripten_get_now() - start_time;
+
+		reference_run = chain_sim_hash(reference_run, a);
+		optimised_run = chain_sim_hash(optimised_run, b);
+
+		if (!sim_hashes_match(a, b)) {
+			printf("[Sim] Diverged at tick %u\n", reference->tick);
+			print_mismatch("clock", a.clock, b.clock);
+			print_mismatch("player", a.player, b.player);
+			print_mismatch("entities", a.entities, b.entities);
+			print_mismatch("particles", a.particles, b.particles);
+			break;
+		}
+	}
+
+	const f64 per_tick = tick > 0 ? 1000.0 / tick : 0;
+	printf("[Sim] %u/%u ticks matched, seed 0x%x, run hash %016llx\n",
+	       tick, ticks, seed, (unsigned long long)optimised_run);
+	printf("[Sim] update_game: reference %.3f us/tick, optimised %.3f us/tick\n",
+	       reference_time * per_tick, optimised_time * per_tick);
+	printf("[Sim] Hashing: %.3f us/tick/game\n", hash_time * per_tick / 2);
+
+	return tick == ticks && reference_run == optimised_run ? 0 : 1;
+}
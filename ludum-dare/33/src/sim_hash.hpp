@@ -0,0 +1,99 @@
+#ifndef SIM_HASH_HPP
+#define SIM_HASH_HPP
+
+#include "game.hpp"
+
+// NOTE(bill): Hash of everything `update_game` reads and writes (the same
+// state as `Sim_State`), split into parts so a mismatch says where to look.
+// Made to be taken every tick: it eats 8 bytes at a time and only touches the
+// live entities and particles. Not stable across builds with different
+// struct layouts, only compare hashes from the same build.
+
+struct Sim_Hash {
+	u64 clock;     // NOTE(bill): Tick, time, random series and timers
+	u64 player;
+	u64 entities;  // Including the level state
+	u64 particles;
+};
+
+inline u64
+mix_hash(u64 hash, u64 value)
+{
+	hash ^= value;
+	hash *= 0x9e3779b97f4a7c15ull;
+	return hash ^ (hash >> 32);
+}
+
+inline u64
+hash_memory(u64 hash, const void* data, size_t size)
+{
+	const u8* bytes = (const u8*)data;
+	for (; size >= 8; bytes += 8, size -= 8) {
+		u64 word;
+		memcpy(&word, bytes, 8);
+		hash = mix_hash(hash, word);
+	}
+	if (size > 0) {
+		u64 word = 0;
+		memcpy(&word, bytes, size);
+		hash = mix_hash(hash, word ^ ((u64)size << 56));
+	}
+	return hash;
+}
+
+inline Sim_Hash
+hash_sim_state(const Game& game)
+{
+	constexpr u64 SEED = 0xcbf29ce484222325ull;
+
+	const Level& level = *game.curr_level;
+
+	Sim_Hash h = {};
+	h.clock    = hash_memory(SEED, &game.tick, sizeof(game.tick));
+	h.clock    = hash_memory(h.clock, &game.sim_time, sizeof(game.sim_time));
+	h.clock    = hash_memory(h.clock, &game.rng, sizeof(game.rng));
+	h.clock    = hash_memory(h.clock, &game.particle_rng, sizeof(game.particle_rng));
+	h.clock    = hash_memory(h.clock, &game.timers, sizeof(game.timers));
+
+	h.player = hash_memory(SEED, &game.player, sizeof(game.player));
+	h.player = hash_memory(h.player, &game.has_finished, sizeof(game.has_finished));
+	h.player = hash_memory(h.player, &game.killed_a_prisoner_cooldown_ends, sizeof(game.killed_a_prisoner_cooldown_ends));
+
+	h.entities = hash_memory(SEED, &level.portal_cooldown_ends, sizeof(level.portal_cooldown_ends));
+	h.entities = hash_memory(h.entities, &level.entity_count, sizeof(level.entity_count));
+	h.entities = hash_memory(h.entities, level.entity_hot, level.entity_count * sizeof(Entity_Hot));
+	h.entities = hash_memory(h.entities, level.entity_cold, level.entity_count * sizeof(Entity_Cold));
+
+	h.particles = hash_memory(SEED, &game.particle_first, sizeof(game.particle_first));
+	h.particles = hash_memory(h.particles, &game.particle_count, sizeof(game.particle_count));
+	for (int i = 0; i < game.particle_count; i++)
+		h.particles = hash_memory(h.particles, &get_particle(game, i), sizeof(Particle));
+
+	return h;
+}
+
+// NOTE(bill): All the parts as one
+inline u64
+get_sim_hash(const Sim_Hash& h)
+{
+	u64 hash = mix_hash(h.clock, h.player);
+	hash     = mix_hash(hash, h.entities);
+	return mix_hash(hash, h.particles);
+}
+
+// NOTE(bill): Folds a tick's hash into one for a whole run, so two runs that
+// end on the same state by different paths still differ
+inline u64
+chain_sim_hash(u64 run_hash, const Sim_Hash& h)
+{
+	return mix_hash(run_hash, get_sim_hash(h));
+}
+
+inline b32
+sim_hashes_match(const Sim_Hash& a, const Sim_Hash& b)
+{
+	return a.clock == b.clock && a.player == b.player &&
+	       a.entities == b.entities && a.particles == b.particles;
+}
+
+#endif
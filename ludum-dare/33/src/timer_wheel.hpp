@@ -0,0 +1,124 @@
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+
+#include "common.hpp"
+
+// NOTE(bill): Hierarchical timer wheel over simulation ticks. Level 0 has a
+// slot per tick for the next 64 ticks, each level above covers 64 times more
+// with a slot per 64 ticks of the level below. A timer sits in the slot of its
+// expiry on the lowest level that reaches it and moves down a level whenever
+// the wheel below wraps, so adding is O(1) and each tick only looks at one
+// slot. Plain data with index links (0 is none), so it copies with `memcpy`
+// and a zeroed wheel is an empty one at tick 0.
+
+constexpr int TIMER_WHEEL_BITS   = 6;
+constexpr int TIMER_WHEEL_SLOTS  = 1 << TIMER_WHEEL_BITS;
+constexpr int TIMER_WHEEL_LEVELS = 4; // NOTE(bill): 64^4 ticks, ~77 hours at 60 Hz
+constexpr int MAX_TIMERS         = 255;
+
+struct Timer {
+	u32 expires; // NOTE(bill): Tick it fires on
+	u32 type;    // What it does, up to the owner
+	u32 data;
+	u16 next;
+};
+
+struct Timer_Wheel {
+	u32 tick;       // NOTE(bill): Last tick `advance_timer_wheel` went through
+	u16 free_list;  // Timers that have fired, before `used`
+	u16 used;       // Timers handed out so far
+	int count;      // Timers waiting to fire
+
+	u16 slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+	Timer timers[MAX_TIMERS + 1]; // NOTE(bill): [0] is never used
+};
+
+// NOTE(bill): Puts a timer in the slot for its expiry, as seen from `now`
+inline void
+link_timer(Timer_Wheel& wheel, u16 index, u32 now)
+{
+	constexpr u32 MAX_DELTA = (1u << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1;
+
+	Timer& timer = wheel.timers[index];
+	if (timer.expires - now > MAX_DELTA)
+		timer.expires = now + MAX_DELTA; // NOTE(bill): Past the top level, fires early
+
+	const u32 delta = timer.expires - now;
+	int level       = 0;
+	while (delta >> (TIMER_WHEEL_BITS * (level + 1)))
+		level++;
+
+	const u32 slot = (timer.expires >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1);
+	timer.next     = wheel.slots[level][slot];
+	wheel.slots[level][slot] = index;
+}
+
+// NOTE(bill): Fires on `expires`, or the next tick if that has already gone.
+// Returns false when all `MAX_TIMERS` are in use.
+inline b32
+add_timer(Timer_Wheel& wheel, u32 expires, u32 type, u32 data = 0)
+{
+	u16 index = wheel.free_list;
+	if (index) {
+		wheel.free_list = wheel.timers[index].next;
+	} else {
+		if (wheel.used == MAX_TIMERS)
+			return false;
+		index = ++wheel.used;
+	}
+
+	if ((s32)(expires - wheel.tick) <= 0)
+		expires = wheel.tick + 1;
+
+	Timer& timer  = wheel.timers[index];
+	timer.expires = expires;
+	timer.type    = type;
+	timer.data    = data;
+	link_timer(wheel, index, wheel.tick);
+	wheel.count++;
+	return true;
+}
+
+// NOTE(bill): Runs the wheel up to and including `tick`, calling
+// `on_expire(const Timer&)` for each timer in the order they expire. Timers
+// added from `on_expire` fire no earlier than the next tick.
+template <typename Fn>
+inline void
+advance_timer_wheel(Timer_Wheel& wheel, u32 tick, Fn&& on_expire)
+{
+	while ((s32)(tick - wheel.tick) > 0) {
+		const u32 now = ++wheel.tick;
+
+		// NOTE(bill): Every level whose lower levels just wrapped drops its
+		// current slot one level down
+		for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+			if ((now & ((1u << (TIMER_WHEEL_BITS * level)) - 1)) != 0)
+				break;
+
+			const u32 slot = (now >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1);
+			u16 index      = wheel.slots[level][slot];
+			wheel.slots[level][slot] = 0;
+			while (index) {
+				const u16 next = wheel.timers[index].next;
+				link_timer(wheel, index, now);
+				index = next;
+			}
+		}
+
+		u16& head = wheel.slots[0][now & (TIMER_WHEEL_SLOTS - 1)];
+		u16 index = head;
+		head      = 0;
+		while (index) {
+			const Timer timer = wheel.timers[index];
+
+			wheel.timers[index].next = wheel.free_list;
+			wheel.free_list          = index;
+			wheel.count--;
+
+			on_expire(timer);
+			index = timer.next;
+		}
+	}
+}
+
+#endif
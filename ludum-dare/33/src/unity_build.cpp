@@ -3,5 +3,7 @@
 
 #include "bitmap.cpp"
 #include "level.cpp"
+#include "level_manager.cpp"
 #include "game.cpp"
+#include "replay.cpp"
 #include "main.cpp"